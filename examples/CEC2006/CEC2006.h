@@ -55,11 +55,11 @@ struct F18 : public CEC_Function<9, 0, 13>  { using Base = CEC_Function<9, 0, 13
 
 struct F19 : public CEC_Function<15, 0, 5>  { using Base = CEC_Function<15, 0, 5>;  F19(); };
 
-struct F20 : public CEC_Function<24, 12, 6> { using Base = CEC_Function<24, 12, 6>; F20(); };
+struct F20 : public CEC_Function<24, 14, 6> { using Base = CEC_Function<24, 14, 6>; F20(); };
 
 struct F21 : public CEC_Function<7, 5, 1>   { using Base = CEC_Function<7, 5, 1>;   F21(); };
 
-struct F22 : public CEC_Function<22, 4, 2>  { using Base = CEC_Function<22, 4, 2>;  F22(); };
+struct F22 : public CEC_Function<22, 19, 1> { using Base = CEC_Function<22, 19, 1>; F22(); };
 
 struct F23 : public CEC_Function<9, 4, 2>   { using Base = CEC_Function<9, 4, 2>;   F23(); };
 
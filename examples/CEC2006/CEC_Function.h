@@ -3,13 +3,17 @@
   * This is a  simple wrappers to make the interface of the CEC functions
   * compatible with MDE functions. The number of variables, equalities and
   * inequalities are always constant, so the 'Vector' type will always be
-  * a 'std::array'.
+  * a 'std::array'. The functions are reentrant: the constraints values are
+  * written to buffers given by the caller (see the fused 'evaluate' function
+  * in 'mde::Function'), so they can be used with any number of threads.
 */
 
 
 #ifndef MDE_CEC_FUNCTION_BASE_H
 #define MDE_CEC_FUNCTION_BASE_H
 
+#include <array>
+
 #include "../../include/MDE/Function.h"
 
 
@@ -28,28 +32,31 @@ struct CEC_Function : public Function<Variables>
     /// The function pointer type of CEC functions
     using CECFunc = void (*)(double*, double*, double*, double*, int);
 
-    /// Number of function evaluations
-    int FEs = 0;
+    /// Number of function evaluations. Can be incremented from many threads at once
+    help::Counter FEs;
 
 
 
     /// Initializes 'func' with the corresponding CEC function
-    CEC_Function (CECFunc func) : func(func) {}
+    CEC_Function (CECFunc func) : func(func)
+    {
+        setConstraints();
+    }
 
-    CEC_Function (CECFunc func, double l, double u, double optimal) : func(func), Base(l, u, optimal) {}
+    CEC_Function (CECFunc func, double l, double u, double optimal) : func(func), Base(l, u, optimal)
+    {
+        setConstraints();
+    }
 
 
 
-    /** The 'operator()' returns the function value given the vector 'x'.
-      * The CEC function is called here only once in the 'operator()'.
-      * This function returns the function values and the values of all
-      * equalities and inequalities. As the 'operator()' function is called
-      * first, there is no need to call the CEC function again to calculate
-      * the equalities and inequalities. They are stored in 'eqs' and 'ineqs'
-      * arrays.
-      *
+    /** The fused evaluation, used by MDE. The CEC function is called only once,
+      * returning the function value and writing the values of all equalities and
+      * inequalities directly to the buffers given by the caller. There is no state
+      * written here besides the evaluations counter, so the same object can be
+      * evaluated from many threads at once.
     */
-    double operator () (const Vector& x)
+    double evaluate (const Vector& x, double* ineqs, double* eqs)
     {
         /// Increase number of function calls
         FEs++;
@@ -57,37 +64,38 @@ struct CEC_Function : public Function<Variables>
         double f;
 
         /// CEC functions receive a non const pointer
-        func(const_cast<double*>(&x[0]), &f, &ineqs[0], &eqs[0], int(x.size()));
+        func(const_cast<double*>(x.data()), &f, ineqs, eqs, int(x.size()));
 
         return f;
     }
 
 
-    /** Equalities and inequalities values are already calculated and stored 
-      * in 'eqs' and 'ineqs'. Notice here the const reference as a return. We
-      * only need to iterate through it's values.
-    */
-    const auto& equalities (const Vector& x)
+    /// Only the function value, for calling it directly. The constraints values are discarded
+    double operator () (const Vector& x)
     {
-        return eqs;
-    }
+        std::array<double, NumEqualities + 1> eqs;
+        std::array<double, NumInequalities + 1> ineqs;
 
-    const auto& inequalities (const Vector& x)
-    {
-        return ineqs;
+        return evaluate(x, ineqs.data(), eqs.data());
     }
 
 
 
-
     CECFunc func;
 
-    std::array<double, NumEqualities> eqs;
-    std::array<double, NumInequalities> ineqs;
+
+private:
+
+    /// The sizes of the buffers given to 'evaluate'
+    void setConstraints ()
+    {
+        this->numInequalities = NumInequalities;
+        this->numEqualities = NumEqualities;
+    }
 };
 
 }
 
 // namespace mde
 
-#endif // MDE_CEC_FUNCTION_BASE_H
\ No newline at end of file
+#endif // MDE_CEC_FUNCTION_BASE_H
@@ -0,0 +1,86 @@
+/**	\file CEC2006Worker.cpp
+  *
+  * Worker for the distributed evaluation of the CEC 2006 functions (see 'Distributed.h'
+  * and 'DistributedExample.cpp'). Run it on any machine that can reach the master:
+  *
+  * MDE_TOKEN=<token of the master> ./CEC2006Worker <function, from 1 to 24> <master host> <master port>
+  *
+  * It evaluates the candidates sent by the master until the master closes the connection.
+  * Without MDE_TOKEN, it sends an empty token.
+*/
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+
+#include "MDE/Distributed.h"	/// Distributed evaluation header
+#include "CEC2006/CEC2006.h"	/// CEC2006 header --- must compile with CEC2006_C_Functions.cpp and CEC2006.cpp
+
+
+/// Answers the requests of the master with the function 'Function'
+template <class Function>
+int serve (const std::string& host, int port, const std::string& token)
+{
+	Function function;
+	typename Function::Vector v;
+
+	/// The master's requests of other sizes end the connection, so exactly 'v.size()' variables arrive
+	return mde::serveTcp(host, port, function.N, function.numInequalities, function.numEqualities,
+						 [&](const double* x, int N, double* inequalities, double* equalities)
+	{
+		std::copy(x, x + N, v.begin());
+
+		return function.evaluate(v, inequalities, equalities);
+	}, token);
+}
+
+
+
+int main (int argc, char** argv)
+{
+	if(argc != 4)
+	{
+		std::cerr << "Usage: " << argv[0] << " <function, from 1 to 24> <master host> <master port>\n";
+		return 1;
+	}
+
+	const int number = std::stoi(argv[1]);
+	const std::string host = argv[2];
+	const int port = std::stoi(argv[3]);
+	const std::string token = std::getenv("MDE_TOKEN") ? std::getenv("MDE_TOKEN") : "";
+
+	using namespace mde::CEC2006;
+
+	switch(number)
+	{
+		case 1:  return serve<F1>(host, port, token);
+		case 2:  return serve<F2>(host, port, token);
+		case 3:  return serve<F3>(host, port, token);
+		case 4:  return serve<F4>(host, port, token);
+		case 5:  return serve<F5>(host, port, token);
+		case 6:  return serve<F6>(host, port, token);
+		case 7:  return serve<F7>(host, port, token);
+		case 8:  return serve<F8>(host, port, token);
+		case 9:  return serve<F9>(host, port, token);
+		case 10: return serve<F10>(host, port, token);
+		case 11: return serve<F11>(host, port, token);
+		case 12: return serve<F12>(host, port, token);
+		case 13: return serve<F13>(host, port, token);
+		case 14: return serve<F14>(host, port, token);
+		case 15: return serve<F15>(host, port, token);
+		case 16: return serve<F16>(host, port, token);
+		case 17: return serve<F17>(host, port, token);
+		case 18: return serve<F18>(host, port, token);
+		case 19: return serve<F19>(host, port, token);
+		case 20: return serve<F20>(host, port, token);
+		case 21: return serve<F21>(host, port, token);
+		case 22: return serve<F22>(host, port, token);
+		case 23: return serve<F23>(host, port, token);
+		case 24: return serve<F24>(host, port, token);
+	}
+
+	std::cerr << "There is no function " << number << "\n";
+
+	return 1;
+}
@@ -0,0 +1,118 @@
+/**	\file DatasetExample.cpp
+  *
+  * This file shows how to fit a model to a large data set using MDE, with each
+  * evaluation split between the threads of MDE
+*/
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <random>
+
+#include "MDE/MDE.h"	/// MDE header
+
+
+/** Least squares fit of a plane to the rows (x0, x1, x2, y) of a data set. The objective is the mean
+  * squared error of the plane over every row. There are many rows and few parameters, so each evaluation
+  * is a reduction over the whole data set, split in shards between the threads (see 'Dataset.h').
+*/
+struct PlaneFit : mde::Function<4>	 /// The four coefficients of the plane
+{
+	PlaneFit (const std::string& path = "")
+	{
+		if(!path.empty())
+			data.open(path, 4);		/// Rows of 4 values, memory mapped
+
+		lowerBounds = {-10.0, -10.0, -10.0, -10.0};
+		upperBounds = {10.0, 10.0, 10.0, 10.0};
+	}
+
+
+	/** MDE gives its pool of threads here. While it evaluates many candidates at once, each 'reduce'
+	  * runs on a single thread. Otherwise (with fewer parents than threads), 'reduce' uses all of them.
+	*/
+	void usePool (mde::help::ThreadPool* pool)
+	{
+		data.usePool(pool);
+	}
+
+
+	/// Mean squared error of the plane 'w' over all the rows
+	double operator () (const Vector& w)
+	{
+		double error = data.reduce([&](const double* rows, int count)
+		{
+			double sum = 0.0;
+
+			for(int r = 0; r < count; ++r, rows += 4)
+			{
+				double e = w[0] * rows[0] + w[1] * rows[1] + w[2] * rows[2] + w[3] - rows[3];
+
+				sum += e * e;
+			}
+
+			return sum;
+		});
+
+		return error / data.rows();
+	}
+
+
+	mde::Dataset data;	 /// Shared by the copies of the function
+};
+
+
+
+/// Writes 'rows' noisy samples of the plane 1.5 x0 - 2 x1 + 0.5 x2 + 3 to 'path'
+void writeSamples (const std::string& path, int rows)
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+	std::normal_distribution<double> noise(0.0, 0.1);
+
+	std::ofstream file(path, std::ios::binary);
+
+	for(int r = 0; r < rows; ++r)
+	{
+		double row[4] = { uniform(generator), uniform(generator), uniform(generator), 0.0 };
+
+		row[3] = 1.5 * row[0] - 2.0 * row[1] + 0.5 * row[2] + 3.0 + noise(generator);
+
+		file.write(reinterpret_cast<const char*>(row), sizeof(row));
+	}
+}
+
+
+
+int main ()
+{
+	const std::string path = "PlaneFitSamples.bin";
+
+	writeSamples(path, 1 << 18);
+
+
+	mde::Parameters params;
+
+	params.threads = 0;		 /// Use every core
+	params.popSize = 8;		 /// With fewer parents than threads, each evaluation uses every core
+	params.maxIter = 300;
+
+
+	mde::MDE<PlaneFit> mdePlane(params, PlaneFit(path));
+
+	auto best = mdePlane();
+
+
+	std::cout << "Plane found (expected 1.5, -2, 0.5, 3):\n\n";
+
+	for(auto x : best)
+		std::cout << x << "   ";
+	std::cout << "\n\n\n";
+
+	std::cout << "Mean squared error:        " << best.fitness << "\n\n";
+
+
+	std::remove(path.c_str());
+
+	return 0;
+}
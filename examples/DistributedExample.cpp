@@ -0,0 +1,81 @@
+/**	\file DistributedExample.cpp
+  *
+  * This file shows how to optimize a CEC 2006 function using MDE, with the evaluations
+  * done by workers on other machines (see 'Distributed.h'). Start the master, then any
+  * number of workers, that may join or leave during the run. Only the workers with the
+  * same token (in the environment variable MDE_TOKEN, that may be empty) are accepted:
+  *
+  * MDE_TOKEN=secret ./DistributedExample 5000 [address to listen on, by default every interface]
+  * MDE_TOKEN=secret ./CEC2006Worker 1 <master host> 5000
+*/
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "MDE/MDE.h"			/// MDE header
+#include "MDE/Distributed.h"	/// Distributed evaluation header
+#include "CEC2006/CEC2006.h"	/// CEC2006 header --- must compile with CEC2006_C_Functions.cpp and CEC2006.cpp
+
+
+/// The function F1 of CEC 2006, whose candidates are evaluated by the workers
+struct DistributedF1 : mde::CEC2006::F1
+{
+	DistributedF1 (const mde::Network& network = mde::Network()) :
+				   pool(std::make_shared<mde::DistributedPool>(N, numInequalities, numEqualities, network)) {}
+
+
+	/// Every candidate of a generation is sent at once, in chunks, to the connected workers
+	void evaluateBatch (mde::Batch& batch)
+	{
+		pool->evaluate(batch);
+	}
+
+
+	std::shared_ptr<mde::DistributedPool> pool;	 /// Shared by the copies of the function
+};
+
+
+
+int main (int argc, char** argv)
+{
+	mde::Network network;
+
+	network.port = argc > 1 ? std::stoi(argv[1]) : 5000;
+
+	if(argc > 2)
+		network.address = argv[2];
+
+	if(const char* token = std::getenv("MDE_TOKEN"))
+		network.token = token;
+
+	mde::Parameters params;
+
+	params.eqTol = 1e-4;
+
+
+	DistributedF1 function(network);
+
+	std::cout << "Waiting for workers on the port " << function.pool->port() << "\n\n";
+
+	function.pool->waitWorkers(1);	 /// Otherwise, the first evaluation waits for them
+
+
+	mde::MDE<DistributedF1> de(params, function);	  /// The initial population is evaluated here, by the workers
+
+	auto best = de();
+
+
+	std::cout << "Best element found:\n\n";
+
+	for(auto x : best)
+		std::cout << x << "   ";
+	std::cout << "\n\n\n";
+
+	std::cout << "Fitness:                   " << best.fitness << "\n\n";
+	std::cout << "Violation:                 " << best.violation << "\n\n";
+	std::cout << "Workers joined:            " << de.function.pool->joined() << "\n\n";
+	std::cout << "Chunks given again:        " << de.function.pool->requeued() << "\n\n";
+
+	return 0;
+}
@@ -21,7 +21,7 @@
  *
  * Here I inherit from 'mde::Function<>'. It is a template, where you can
  * pass the number of variables at compile time to have a 'std::array' as
- * the 'Vector' type instead of a 'std::vector'. However, this way I can
+ * the 'Vector' type instead of a 'std::vector' like type. However, this way I can
  * decide the number of parameters at runtime.
  *
 
@@ -47,10 +47,12 @@ struct Ackley : public mde::Function<>	 /// Inheriting from 'mde::Function<>'
     }
 
 
-    /** This is where the function value is returned from a given vector 'v'.  In this case, as the 
-      * 'Vector' class inherits from 'std::vector', you could really just use:
+    /** This is where the function value is returned from a given vector 'v'.  In this case, the
+      * 'Vector' class has the same interface of 'std::vector', and you could really just use:
       *
       *	double operator () (const std::vector<double>& v)
+      *
+      * The values are then copied to a reused 'std::vector' before each call.
     */
     double operator () (const Vector& v)
     {
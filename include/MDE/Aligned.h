@@ -0,0 +1,100 @@
+/** \file Aligned.h
+  *
+  * Helpers for allocating memory aligned to the size of a cache line. Every
+  * block returned here starts at a multiple of 'help::cacheLine' bytes, which
+  * is also enough for any SIMD load or store (up to AVX-512). Example:
+  *
+  * std::vector<double, help::AlignedAllocator<double>> v(100);   // 'v.data()' is 64 bytes aligned
+*/
+
+#ifndef MDE_ALIGNED_H
+#define MDE_ALIGNED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+
+namespace mde
+{
+
+namespace help
+{
+
+/// Size of a cache line, in bytes
+constexpr std::size_t cacheLine = 64;
+
+
+
+/** Allocates 'bytes' bytes aligned to 'alignment' (a power of two). The original pointer
+  * is stored right before the returned block, so 'alignedFree' can release it.
+*/
+inline void* alignedMalloc (std::size_t bytes, std::size_t alignment = cacheLine)
+{
+    void* raw = ::operator new(bytes + alignment + sizeof(void*));
+
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+    std::uintptr_t aligned = (start + alignment - 1) & ~std::uintptr_t(alignment - 1);
+
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+
+    return reinterpret_cast<void*>(aligned);
+}
+
+/// Releases a block returned by 'alignedMalloc'
+inline void alignedFree (void* p)
+{
+    if(p)
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+}
+
+
+
+/// Standard allocator interface on top of 'alignedMalloc', to be used with 'std::vector'
+template <typename T, std::size_t Alignment = cacheLine>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+
+    AlignedAllocator () = default;
+
+    template <typename U>
+    AlignedAllocator (const AlignedAllocator<U, Alignment>&) {}
+
+
+    T* allocate (std::size_t n)
+    {
+        return static_cast<T*>(alignedMalloc(n * sizeof(T), Alignment));
+    }
+
+    void deallocate (T* p, std::size_t)
+    {
+        alignedFree(p);
+    }
+
+
+    template <typename U>
+    bool operator == (const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template <typename U>
+    bool operator != (const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+
+/// Number of elements of type 'T' that fill an entire number of cache lines and can hold 'n' elements
+template <typename T>
+constexpr std::size_t paddedSize (std::size_t n)
+{
+    return (n * sizeof(T) + cacheLine - 1) / cacheLine * cacheLine / sizeof(T);
+}
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_ALIGNED_H
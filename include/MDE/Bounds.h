@@ -0,0 +1,182 @@
+/** \file Bounds.h
+  *
+  * Bounds handling policies. They decide what to do with a child generated
+  * outside the box [lower, upper]. The policy is a template parameter of the
+  * 'MDE' class, so the repair step is inlined right after the mutation, without
+  * any indirect call. If the policy is only known at runtime, 'bounds::Runtime'
+  * (the default) chooses it by the name given in 'Parameters::bndHandle'. Example:
+  *
+  * mde::MDE<Function, mde::bounds::Clip> mde;      // Always clips, 'bndHandle' is ignored
+  *
+  * mde::MDE<Function> mde(params);                 // Uses 'params.bndHandle'
+  *
+  * Every policy has the same interface:
+  *
+  * void operator () (double* child, const double* parent, const double* lower,
+  *                   const double* upper, int N, help::RandDouble& randDouble);
+  *
+  * The methods are described here:
+  *
+  * https://elektron.elka.pw.edu.pl/~jarabas/ALHE/krakow1.pdf
+  *
+  * All of them work on the whole row at once, using the SIMD kernels of 'Kernels.h'.
+*/
+
+#ifndef MDE_BOUNDS_H
+#define MDE_BOUNDS_H
+
+#include <string>
+#include <algorithm>
+#include <cctype>
+#include <assert.h>
+
+#include "Random.h"
+#include "Kernels.h"
+
+
+namespace mde
+{
+
+namespace bounds
+{
+
+/// If a dimension 'i' is outside the box, set the value of this dimension to the value of the parent
+struct Conservate
+{
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble&) const
+    {
+        help::conservateBounds({ child, parent, lower, upper, N });
+    }
+};
+
+
+/// If any dimension is outside the box, the whole child is replaced by the parent
+struct ConservateAll
+{
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble&) const
+    {
+        if(help::outsideBounds({ child, parent, lower, upper, N }))
+            std::copy(parent, parent + N, child);
+    }
+};
+
+
+/// Clip every dimension 'i' to stay in the range:   lower[i] <= x[i] <= upper[i]
+struct Clip
+{
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble&) const
+    {
+        help::clipBounds({ child, parent, lower, upper, N });
+    }
+};
+
+
+/// If any component is outside the box, generate a new random vector
+struct Reinitialize
+{
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble& randDouble) const
+    {
+        if(help::outsideBounds({ child, parent, lower, upper, N }))
+            for(int i = 0; i < N; ++i)
+                child[i] = randDouble(lower[i], upper[i]);
+    }
+};
+
+
+/// A dimension outside the box is mirrored at the violated bound:   x[i] = 2 * lower[i] - x[i]
+struct Reflection
+{
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble&) const
+    {
+        help::reflectBounds({ child, parent, lower, upper, N });
+    }
+};
+
+
+/// A dimension outside the box is set to the midpoint between the violated bound and the parent
+struct Midpoint
+{
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble&) const
+    {
+        help::midpointBounds({ child, parent, lower, upper, N });
+    }
+};
+
+
+
+/** Chooses one of the policies above at runtime. 'set' is called once, by 'MDE::initialize', with
+  * the name given in 'Parameters::bndHandle'. The call itself is only a switch on an enum.
+*/
+struct Runtime
+{
+    enum class Mode { Conservate, ConservateAll, Clip, Reinitialize, Reflection, Midpoint };
+
+
+    /// Sets the mode given its name (case insensitive)
+    void set (std::string name)
+    {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        if(name == "conservate")
+            mode = Mode::Conservate;
+
+        else if(name == "conservateall")
+            mode = Mode::ConservateAll;
+
+        else if(name == "clip")
+            mode = Mode::Clip;
+
+        else if(name == "reinitialize")
+            mode = Mode::Reinitialize;
+
+        else if(name == "reflection")
+            mode = Mode::Reflection;
+
+        else if(name == "midpoint")
+            mode = Mode::Midpoint;
+
+        else
+            assert(0 && "Invalid Bound handling option");
+    }
+
+
+    inline void operator () (double* child, const double* parent, const double* lower,
+                             const double* upper, int N, ::help::RandDouble& randDouble) const
+    {
+        switch(mode)
+        {
+            case Mode::Conservate:    Conservate()(child, parent, lower, upper, N, randDouble);    break;
+            case Mode::ConservateAll: ConservateAll()(child, parent, lower, upper, N, randDouble); break;
+            case Mode::Clip:          Clip()(child, parent, lower, upper, N, randDouble);          break;
+            case Mode::Reinitialize:  Reinitialize()(child, parent, lower, upper, N, randDouble);  break;
+            case Mode::Reflection:    Reflection()(child, parent, lower, upper, N, randDouble);    break;
+            case Mode::Midpoint:      Midpoint()(child, parent, lower, upper, N, randDouble);      break;
+        }
+    }
+
+
+    Mode mode = Mode::Conservate;
+};
+
+
+/// Only 'Runtime' needs to know the name of the policy. The others ignore it
+template <class Policy>
+inline void set (Policy&, const std::string&) {}
+
+inline void set (Runtime& policy, const std::string& name)
+{
+    policy.set(name);
+}
+
+} // namespace bounds
+
+} // namespace mde
+
+
+#endif // MDE_BOUNDS_H
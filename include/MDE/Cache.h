@@ -0,0 +1,297 @@
+/** \file Cache.h
+  *
+  * A bounded cache of evaluations, indexed by the coordinates of the candidates.
+  * When a child is identical to a candidate evaluated before (a child repaired
+  * back onto its parent, for example), its values are taken from here and the
+  * function is not called. The key is the exact coordinates or, if a 'resolution'
+  * is given, the coordinates rounded to multiples of it. When the cache is full,
+  * the least recently used entry is replaced. All the memory is allocated by
+  * 'resize'. It is safe to use from many threads at once. Example:
+  *
+  * help::EvaluationCache cache(1000, N, 2);    // 1000 entries, 'N' variables, 2 values each
+  *
+  * std::uint64_t hash = cache.key(x, key);     // Writes the key of 'x' to 'key'
+  *
+  * if(!cache.find(key, hash, values))          // Copies the values on a hit
+  *     cache.insert(key, hash, evaluate(x, values));
+*/
+
+#ifndef MDE_CACHE_H
+#define MDE_CACHE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+
+namespace mde
+{
+
+namespace help
+{
+
+/// Final step of the 'splitmix64' generator. Spreads the bits of 'x'
+inline std::uint64_t mixBits (std::uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+    return x ^ (x >> 31);
+}
+
+
+/** Writes the key of the 'N' coordinates of 'x' to 'key' and returns its hash. With a positive 'resolution',
+  * the coordinates are rounded to multiples of it. Used by 'EvaluationCache' and 'PersistentStore'.
+*/
+inline std::uint64_t candidateKey (const double* x, double* key, int N, double resolution = 0.0)
+{
+    std::uint64_t hash = 0x9E3779B97F4A7C15ULL;
+
+    for(int j = 0; j < N; ++j)
+    {
+        key[j] = (resolution > 0.0 ? std::round(x[j] / resolution) : x[j]) + 0.0;   /// '+ 0.0' turns -0.0 into 0.0
+
+        std::uint64_t u;
+
+        std::memcpy(&u, &key[j], sizeof(double));
+
+        hash = mixBits(hash ^ u);
+    }
+
+    return hash;
+}
+
+
+
+class EvaluationCache
+{
+public:
+
+    EvaluationCache (std::size_t capacity = 0, int N = 0, int numValues = 0, double resolution = 0.0)
+    {
+        resize(capacity, N, numValues, resolution);
+    }
+
+
+    /** Room for 'capacity' entries of 'N' coordinates and 'numValues' values each. With a positive
+      * 'resolution', the coordinates are rounded to multiples of it. The cache is cleared.
+    */
+    void resize (std::size_t capacity, int N, int numValues, double resolution = 0.0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        this->capacity = capacity;
+        this->N = N;
+        this->numValues = numValues;
+        this->resolution = resolution;
+
+        std::size_t numBuckets = 1;
+
+        while(numBuckets < capacity)
+            numBuckets *= 2;
+
+        keys.resize(capacity * N);
+        values.resize(capacity * numValues);
+        hashes.resize(capacity);
+        chain.resize(capacity);
+        newer.resize(capacity);
+        older.resize(capacity);
+        buckets.resize(numBuckets);
+
+        clearEntries();
+    }
+
+    /** Number of bytes used by each entry, counting up to two buckets of the hash table. Used to turn a
+      * memory budget into a number of entries
+    */
+    static std::size_t entryBytes (int N, int numValues)
+    {
+        return (N + numValues) * sizeof(double) + sizeof(std::uint64_t) + 5 * sizeof(int);
+    }
+
+
+    /// Removes every entry and resets the counters
+    void clear ()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        clearEntries();
+    }
+
+
+
+    /// Writes the key of the 'N' coordinates of 'x' to 'key' and returns its hash
+    std::uint64_t key (const double* x, double* key) const
+    {
+        return candidateKey(x, key, N, resolution);
+    }
+
+
+    /// If the 'key' is in the cache, copies its values to 'out', marks it as the most recently used and returns true
+    bool find (const double* key, std::uint64_t hash, double* out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        int e = lookup(key, hash);
+
+        if(e < 0)
+        {
+            numMisses++;
+            return false;
+        }
+
+        numHits++;
+
+        std::copy(entryValues(e), entryValues(e) + numValues, out);
+
+        unlink(e);
+        pushNewest(e);
+
+        return true;
+    }
+
+
+    /// Adds the 'key' with the values 'in', replacing the least recently used entry if the cache is full
+    void insert (const double* key, std::uint64_t hash, const double* in)
+    {
+        if(capacity == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        int e = lookup(key, hash);
+
+        if(e >= 0)    /// Already there (inserted by another thread), so only refresh it
+            unlink(e);
+
+        else
+        {
+            if(size < capacity)
+                e = int(size++);
+
+            else
+            {
+                e = oldest;
+                unlink(e);
+                removeFromBucket(e);
+            }
+
+            std::copy(key, key + N, entryKey(e));
+
+            hashes[e] = hash;
+
+            int& head = buckets[hash & (buckets.size() - 1)];
+
+            chain[e] = head;
+            head = e;
+        }
+
+        std::copy(in, in + numValues, entryValues(e));
+
+        pushNewest(e);
+    }
+
+
+
+    long hits () const { std::lock_guard<std::mutex> lock(mutex); return numHits; }       /// Number of successful 'find' calls
+    long misses () const { std::lock_guard<std::mutex> lock(mutex); return numMisses; }   /// Number of failed 'find' calls
+
+    std::size_t entries () const { std::lock_guard<std::mutex> lock(mutex); return size; }   /// Number of entries in use
+
+
+
+private:
+
+    double* entryKey (int e) { return keys.data() + std::size_t(e) * N; }
+    double* entryValues (int e) { return values.data() + std::size_t(e) * numValues; }
+
+
+    /// The entry with the given key, or -1
+    int lookup (const double* key, std::uint64_t hash)
+    {
+        if(capacity == 0)
+            return -1;
+
+        for(int e = buckets[hash & (buckets.size() - 1)]; e >= 0; e = chain[e])
+            if(hashes[e] == hash && std::equal(key, key + N, entryKey(e)))
+                return e;
+
+        return -1;
+    }
+
+
+    void removeFromBucket (int e)
+    {
+        int* link = &buckets[hashes[e] & (buckets.size() - 1)];
+
+        while(*link != e)
+            link = &chain[*link];
+
+        *link = chain[e];
+    }
+
+
+    /// The entries form a doubly linked list, from the most recently used ('newest') to the least ('oldest')
+    void unlink (int e)
+    {
+        (older[e] >= 0 ? newer[older[e]] : oldest) = newer[e];
+        (newer[e] >= 0 ? older[newer[e]] : newest) = older[e];
+    }
+
+    void pushNewest (int e)
+    {
+        newer[e] = -1;
+        older[e] = newest;
+
+        (newest >= 0 ? newer[newest] : oldest) = e;
+
+        newest = e;
+    }
+
+
+    void clearEntries ()
+    {
+        std::fill(buckets.begin(), buckets.end(), -1);
+
+        size = 0;
+        newest = oldest = -1;
+        numHits = numMisses = 0;
+    }
+
+
+
+    std::size_t capacity = 0;   /// Maximum number of entries
+    std::size_t size = 0;       /// Number of entries in use
+
+    int N = 0;                  /// Number of coordinates of each key
+    int numValues = 0;          /// Number of values of each entry
+    double resolution = 0.0;    /// If positive, the coordinates are rounded to multiples of it
+
+    std::vector<double> keys;            /// 'N' coordinates for each entry
+    std::vector<double> values;          /// 'numValues' values for each entry
+    std::vector<std::uint64_t> hashes;   /// Hash of each entry
+
+    std::vector<int> buckets;   /// First entry of each bucket of the hash table, or -1
+    std::vector<int> chain;     /// Next entry in the same bucket, or -1
+
+    std::vector<int> newer;     /// Recency list. See 'unlink'
+    std::vector<int> older;
+
+    int newest = -1;
+    int oldest = -1;
+
+    long numHits = 0;
+    long numMisses = 0;
+
+    mutable std::mutex mutex;
+};
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_CACHE_H
@@ -0,0 +1,248 @@
+/** \file Dataset.h
+  *
+  * A read-only table of doubles, mapped from a file, for objectives that are
+  * reductions over many rows of data (the error of a model fitted to a data set,
+  * for example). The file has only the values, row after row. The rows are split
+  * into shards of consecutive rows, and 'reduce' adds the values of a function
+  * of each shard, in parallel if a pool is given. The partial values are added
+  * in the order of the shards, so the result is the same with any number of
+  * threads. Example:
+  *
+  * mde::Dataset data("points.bin", 4);    // Rows of 4 values
+  *
+  * double error = data.reduce([&](const double* rows, int count)
+  * {
+  *     double sum = 0.0;
+  *
+  *     for(int r = 0; r < count; ++r, rows += 4)
+  *         sum += std::pow(model(x, rows) - rows[3], 2);
+  *
+  *     return sum;
+  * });
+  *
+  * Inside a function, the pool of MDE is given to the data set by 'usePool' (see
+  * 'mde::Function'). While that pool evaluates many candidates at once, each
+  * 'reduce' runs on its calling thread (see 'help::ThreadPool::run'), so the
+  * cores are never oversubscribed. The copies of a 'Dataset' share the same data.
+  *
+  * On POSIX systems, the file is memory mapped. Elsewhere, it is read into memory.
+*/
+
+#ifndef MDE_DATASET_H
+#define MDE_DATASET_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define MDE_DATASET_POSIX
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "ThreadPool.h"
+
+
+namespace mde
+{
+
+class Dataset
+{
+public:
+
+    Dataset () = default;
+
+    /// See 'open'
+    Dataset (const std::string& path, int columns, int shardRows = 16384)
+    {
+        open(path, columns, shardRows);
+    }
+
+
+    /** Maps the file at 'path', whose rows have 'columns' values each. 'reduce' gives the rows to the function in
+      * shards of 'shardRows' rows. Throws 'std::runtime_error' if the file can't be read, or if its size is not a
+      * multiple of the size of a row.
+    */
+    void open (const std::string& path, int columns, int shardRows = 16384)
+    {
+        auto mapping = std::make_shared<Mapping>(path);
+
+        const std::size_t rowBytes = std::size_t(columns) * sizeof(double);
+
+        if(columns <= 0 || mapping->bytes % rowBytes != 0)
+            throw std::runtime_error("The size of " + path + " is not a multiple of the size of a row");
+
+        data = mapping;
+        numColumns = columns;
+        numRows = mapping->bytes / rowBytes;
+        this->shardRows = std::max(1, shardRows);
+    }
+
+    /// Releases the data. The other copies still have it
+    void close ()
+    {
+        data.reset();
+        numRows = 0;
+    }
+
+    bool isOpen () const { return data != nullptr; }
+
+
+
+    std::size_t rows () const { return numRows; }
+
+    int columns () const { return numColumns; }
+
+    /// Number of shards. The last one may have fewer rows
+    int shards () const { return int((numRows + shardRows - 1) / shardRows); }
+
+    /// The 'columns' values of the row 'r'
+    const double* row (std::size_t r) const { return data->values + r * numColumns; }
+
+
+
+    /// Pool used by 'reduce'. With 'nullptr' (the default), everything runs on the calling thread
+    void usePool (help::ThreadPool* pool)
+    {
+        this->pool = pool;
+    }
+
+
+    /** Sum of 'f(rows, count)' over the shards, where 'rows' points to the first of the 'count' rows of a shard. The
+      * shards are given to the workers of the pool, if there is one and it is not busy with an outer loop, and their
+      * values are added in order. No memory is allocated after the first call of each thread.
+    */
+    template <class F>
+    double reduce (F&& f) const
+    {
+        const int numShards = shards();
+
+        auto shard = [&](int s)
+        {
+            const std::size_t first = std::size_t(s) * shardRows;
+
+            return f(row(first), int(std::min<std::size_t>(shardRows, numRows - first)));
+        };
+
+        if(!pool || pool->busy() || numShards < 2)
+        {
+            double total = 0.0;
+
+            for(int s = 0; s < numShards; ++s)
+                total += shard(s);
+
+            return total;
+        }
+
+
+        /// Taken from the buffer of the thread, so a nested 'reduce' (from 'f') uses another one
+        std::vector<double> partials = std::move(buffer());
+
+        partials.resize(numShards);
+
+        pool->run(numShards, [&](int s, int){ partials[s] = shard(s); });
+
+        double total = 0.0;
+
+        for(int s = 0; s < numShards; ++s)
+            total += partials[s];
+
+        buffer() = std::move(partials);
+
+        return total;
+    }
+
+
+
+private:
+
+    /// The values of the file, shared by the copies
+    struct Mapping
+    {
+        explicit Mapping (const std::string& path)
+        {
+#ifdef MDE_DATASET_POSIX
+            const int fd = ::open(path.c_str(), O_RDONLY);
+
+            if(fd < 0)
+                throw std::runtime_error("Could not open the dataset " + path);
+
+            struct stat info;
+
+            ::fstat(fd, &info);
+
+            bytes = std::size_t(info.st_size);
+
+            void* address = bytes ? ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+
+            ::close(fd);    /// The mapping stays valid
+
+            if(address == MAP_FAILED)
+                throw std::runtime_error("Could not map the dataset " + path);
+
+            values = static_cast<const double*>(address);
+#else
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+            if(!file)
+                throw std::runtime_error("Could not open the dataset " + path);
+
+            bytes = std::size_t(file.tellg());
+
+            copy.resize(bytes / sizeof(double));
+
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(copy.data()), std::streamsize(copy.size() * sizeof(double)));
+
+            values = copy.data();
+#endif
+        }
+
+        ~Mapping ()
+        {
+#ifdef MDE_DATASET_POSIX
+            if(values)
+                ::munmap(const_cast<double*>(values), bytes);
+#endif
+        }
+
+        Mapping (const Mapping&) = delete;
+        Mapping& operator = (const Mapping&) = delete;
+
+
+        const double* values = nullptr;
+        std::size_t bytes = 0;
+
+        std::vector<double> copy;   /// Only used if the file can't be mapped
+    };
+
+
+    /// Partial values of 'reduce', one buffer per thread
+    static std::vector<double>& buffer ()
+    {
+        static thread_local std::vector<double> partials;
+
+        return partials;
+    }
+
+
+
+    std::shared_ptr<const Mapping> data;
+
+    std::size_t numRows = 0;
+    int numColumns = 0;
+    int shardRows = 16384;
+
+    help::ThreadPool* pool = nullptr;   /// Not owned
+};
+
+} // namespace mde
+
+
+#endif // MDE_DATASET_H
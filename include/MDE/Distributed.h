@@ -0,0 +1,702 @@
+/** \file Distributed.h
+  *
+  * Evaluation by worker processes on other machines, connected through TCP. The
+  * master ('DistributedPool') listens on a port. The workers ('serveTcp') connect
+  * to it whenever they start, and may leave at any time. Each block of candidates
+  * (see 'mde::Batch') is split in chunks, that are sent to the workers with the
+  * same binary protocol of 'SubprocessPool' (see 'Subprocess.h'). Up to 'depth'
+  * chunks are sent to each worker before it answers the first one, so it never
+  * waits for the network, but never more than that, so the faster workers take
+  * more chunks.
+  *
+  * Before any request, the master sends a hello with the version of the protocol
+  * and the sizes of the problem, that the worker checks. The worker answers with
+  * the token given to both (see 'Network'), and only then it gets candidates. So
+  * a worker of another problem or version, or a peer without the token, never
+  * exchanges candidates with the master. The token is sent in the clear: on an
+  * untrusted network, use a tunnel.
+  *
+  * If a worker leaves (or crashes, or takes more than 'timeout' seconds per
+  * candidate), its connection is closed and the chunks it was evaluating are given
+  * to the other workers, one candidate at a time. A candidate lost twice alone
+  * gets an infinite fitness and infinite constraints values. Example:
+  *
+  * // Master
+  * struct Problem : mde::CEC2006::F1
+  * {
+  *     void evaluateBatch (mde::Batch& batch) { pool->evaluate(batch); }
+  *
+  *     std::shared_ptr<mde::DistributedPool> pool = std::make_shared<mde::DistributedPool>(
+  *         N, numInequalities, numEqualities, mde::Network{ 5000, "0.0.0.0", "secret" });
+  * };
+  *
+  * // Each worker
+  * mde::CEC2006::F1 f;
+  * mde::CEC2006::F1::Vector v;
+  *
+  * mde::serveTcp("master.host", 5000, f.N, f.numInequalities, f.numEqualities, [&](const double* x, int N, double* inequalities, double* equalities)
+  * {
+  *     std::copy(x, x + N, v.begin());
+  *
+  *     return f.evaluate(v, inequalities, equalities);
+  * }, "secret");
+  *
+  * While there are no workers, 'evaluate' waits for them. Only available on POSIX
+  * systems. Elsewhere, the constructor throws.
+*/
+
+#ifndef MDE_DISTRIBUTED_H
+#define MDE_DISTRIBUTED_H
+
+#include <vector>
+#include <string>
+#include <deque>
+
+#include "Subprocess.h"
+
+#ifdef MDE_SUBPROCESS_POSIX
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+#endif
+
+
+namespace mde
+{
+
+/// Where the master of a 'DistributedPool' listens, and what its workers must send to be accepted
+struct Network
+{
+    int port = 0;                       /// With 0, a free port is chosen. See 'DistributedPool::port'
+
+    std::string address = "0.0.0.0";    /// IPv4 address of the interface. "0.0.0.0" for every one, "127.0.0.1" for this machine only
+
+    std::string token;                  /// Shared secret of the workers, given to 'serveTcp'. Empty for none
+};
+
+
+namespace help
+{
+
+/// First values of the hello of the master and of the answer of a worker. See the beginning of the file
+constexpr std::uint32_t helloMagic = 0x4D444548;
+constexpr std::uint32_t helloVersion = 1;
+
+/// Seconds a new worker has to answer the hello of the master
+constexpr double helloTimeout = 5.0;
+
+} // namespace help
+
+
+class DistributedPool
+{
+public:
+
+    /** Evaluates the candidates of a problem with 'N' variables, 'numInequalities' inequalities and 'numEqualities'
+      * equalities, listening as given by 'network'. With a positive 'timeout', a worker that takes more than
+      * 'timeout' seconds per candidate is dropped. Each request has up to 'chunk' candidates. With 0, a block is
+      * split evenly between the chunks in flight of every worker. Each worker has up to 'depth' requests in flight.
+    */
+    DistributedPool (int N, int numInequalities, int numEqualities, const Network& network = Network(),
+                     double timeout = 0.0, int chunk = 0, int depth = 2) :
+                     N(N), numInequalities(numInequalities), numEqualities(numEqualities), token(network.token),
+                     timeout(timeout), chunk(chunk), depth(std::max(1, depth))
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        sockaddr_in address{};
+
+        address.sin_family = AF_INET;
+        address.sin_port = htons(std::uint16_t(network.port));
+
+        if(::inet_pton(AF_INET, network.address.c_str(), &address.sin_addr) != 1)
+            throw std::runtime_error("Invalid address to listen on: " + network.address);
+
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        if(listener < 0)
+            throw std::runtime_error("Could not create the socket of the master");
+
+        const int yes = 1;
+
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        ::fcntl(listener, F_SETFD, FD_CLOEXEC);
+        ::fcntl(listener, F_SETFL, ::fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+        if(::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0)
+        {
+            ::close(listener);
+            throw std::runtime_error("Could not listen on " + network.address + ":" + std::to_string(network.port));
+        }
+
+        socklen_t length = sizeof(address);
+
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+
+        listenPort = ntohs(address.sin_port);
+#else
+        (void)network;
+
+        throw std::runtime_error("The distributed pool is only available on POSIX systems");
+#endif
+    }
+
+    DistributedPool (const DistributedPool&) = delete;
+    DistributedPool& operator = (const DistributedPool&) = delete;
+
+
+    /// Closes every connection, so the workers return from 'serveTcp'
+    ~DistributedPool ()
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        for(auto& worker : workers)
+            ::close(worker.fd);
+
+        ::close(listener);
+#endif
+    }
+
+
+
+    /** Evaluates every candidate of 'batch' in the workers, writing the fitness and the constraints values. It only
+      * returns when every candidate is done (or failed, see the beginning of the file), waiting for workers to join
+      * if there are none. Throws if the sizes of 'batch' are not the ones given to the constructor.
+    */
+    void evaluate (Batch& batch)
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        if(batch.N != N || batch.numInequalities != numInequalities || batch.numEqualities != numEqualities)
+            throw std::runtime_error("The batch has other sizes than the distributed pool");
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        accept();
+
+        const int slots = std::max(1, size()) * depth;
+        const int perChunk = chunk > 0 ? chunk : std::max(1, (batch.count + slots - 1) / slots);
+
+        tasks.clear();
+
+        for(int first = 0; first < batch.count; first += perChunk)
+            tasks.push_back(Task{ first, std::min(perChunk, batch.count - first), 0 });
+
+        std::reverse(tasks.begin(), tasks.end());    /// Taken from the back, so in order
+
+        int pending = int(tasks.size());    /// Chunks not done yet, in flight or not
+
+        while(pending > 0)
+        {
+            /// Fill the free slots of every worker that answered the hello
+            for(auto& worker : workers)
+                while(worker.ready && int(worker.inFlight.size()) < depth && !tasks.empty())
+                {
+                    send(worker, batch, tasks.back());
+                    tasks.pop_back();
+                }
+
+            progress(batch, pending, -1);
+        }
+#else
+        (void)batch;
+#endif
+    }
+
+
+    /** Waits until at least 'count' workers are connected and answered the hello, or 'seconds' pass (forever, if
+      * not positive). Returns true if they are.
+    */
+    bool waitWorkers (int count, double seconds = 0.0)
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+        Batch none{};    /// Nothing is in flight here
+        int pending = 0;
+
+        accept();
+
+        while(size() < count)
+        {
+            const long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+
+            if(seconds > 0.0 && left <= 0)
+                return false;
+
+            progress(none, pending, seconds > 0.0 ? left + 1 : -1);
+        }
+#else
+        (void)seconds;
+#endif
+        return size() >= count;
+    }
+
+
+
+    /// Port where the master listens
+    int port () const { return listenPort; }
+
+    /// Number of connected workers that answered the hello, as of the last 'evaluate' or 'waitWorkers'
+    int size () const { return int(std::count_if(workers.begin(), workers.end(), [](const Worker& worker){ return worker.ready; })); }
+
+    /// Number of workers that joined, answering the hello
+    long joined () const { return numJoined; }
+
+    /// Number of workers dropped because they left, failed or timed out, after answering the hello
+    long dropped () const { return numDropped; }
+
+    /// Number of connections closed because they did not answer the hello in time, or answered it wrongly
+    long rejected () const { return numRejected; }
+
+    /// Number of chunks given to another worker after a worker was dropped
+    long requeued () const { return numRequeued; }
+
+    /// Number of candidates lost twice alone, that got infinite values
+    long failures () const { return numFailures; }
+
+
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+
+    /// Candidates [first, first + count) of the current block. 'attempts' counts the losses of a single candidate
+    struct Task
+    {
+        int first;
+        int count;
+        int attempts;
+    };
+
+    struct Worker
+    {
+        int fd;
+        bool ready = false;               /// If it answered the hello. Until then, it gets no requests
+
+        std::deque<Task> inFlight;        /// Sent, and not answered yet, in order
+        Clock::time_point deadline;       /// For the answer of the hello, and then of the first request
+
+        std::vector<char> out;            /// Requests being written, and how much of them was
+        std::size_t written = 0;
+
+        std::vector<char> in;             /// Answer of the hello or of the first request in flight, and how much of it was read
+        std::size_t received = 0;
+    };
+
+
+
+#ifdef MDE_SUBPROCESS_POSIX
+
+    /// Takes every worker waiting to connect, sending it the hello
+    void accept ()
+    {
+        int fd;
+
+        while((fd = ::accept(listener, nullptr, nullptr)) >= 0)
+        {
+            const int yes = 1;
+
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+            ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+            const std::uint32_t hello[5] = { help::helloMagic, help::helloVersion, std::uint32_t(N),
+                                             std::uint32_t(numInequalities), std::uint32_t(numEqualities) };
+
+            workers.emplace_back();
+
+            Worker& worker = workers.back();
+
+            worker.fd = fd;
+            worker.out.assign(reinterpret_cast<const char*>(hello), reinterpret_cast<const char*>(hello) + sizeof(hello));
+            worker.in.resize(3 * sizeof(std::uint32_t) + token.size());
+            worker.deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(help::helloTimeout));
+        }
+    }
+
+    /// If the answer of 'worker' to the hello, already read, has the right version and token
+    bool greeted (const Worker& worker) const
+    {
+        std::uint32_t answer[3];
+
+        std::memcpy(answer, worker.in.data(), sizeof(answer));
+
+        if(answer[0] != help::helloMagic || answer[1] != help::helloVersion || answer[2] != std::uint32_t(token.size()))
+            return false;
+
+        unsigned char difference = 0;    /// Comparing every character, so the time does not tell where they differ
+
+        for(std::size_t i = 0; i < token.size(); ++i)
+            difference |= static_cast<unsigned char>(worker.in[sizeof(answer) + i] ^ token[i]);
+
+        return difference == 0;
+    }
+
+
+    /** Waits up to 'wait' milliseconds (forever, if negative) for new workers, answers, room to write, or the
+      * nearest deadline, and handles them. The workers that failed are dropped.
+    */
+    void progress (Batch& batch, int& pending, long long wait)
+    {
+        polls.assign(1, pollfd{ listener, POLLIN, 0 });
+
+        for(auto& worker : workers)
+        {
+            short events = POLLIN;
+
+            if(worker.written < worker.out.size())
+                events |= POLLOUT;
+
+            polls.push_back(pollfd{ worker.fd, events, 0 });
+
+            if(timed(worker))
+            {
+                const long long left = std::max<long long>(0, 1 + std::chrono::duration_cast<std::chrono::milliseconds>(worker.deadline - Clock::now()).count());
+
+                wait = wait < 0 ? left : std::min(wait, left);
+            }
+        }
+
+        ::poll(polls.data(), polls.size(), int(std::min<long long>(wait, std::numeric_limits<int>::max())));
+
+
+        /// The new workers are polled in the next round
+        const std::size_t polled = polls.size() - 1;
+
+        if(polls[0].revents & POLLIN)
+            accept();
+
+        for(std::size_t w = 0, p = 1; p <= polled; ++p)
+        {
+            Worker& worker = workers[w];
+
+            const short events = polls[p].revents;
+
+            bool failed = false;
+
+            if(events & POLLOUT)
+                failed = !write(worker);
+
+            if(!failed && (events & (POLLIN | POLLHUP | POLLERR)))
+                failed = !read(worker, batch, pending);
+
+            if(failed || (timed(worker) && Clock::now() > worker.deadline))
+            {
+                drop(worker, batch, pending);
+                workers.erase(workers.begin() + w);
+            }
+
+            else
+                ++w;
+        }
+    }
+
+    /// If the deadline of 'worker' counts: for the hello, or with a timeout, for its requests
+    bool timed (const Worker& worker) const
+    {
+        return !worker.ready || (timeout > 0.0 && !worker.inFlight.empty());
+    }
+
+
+    /// Adds the request of the candidates of 'task' to the ones being written to 'worker'
+    void send (Worker& worker, const Batch& batch, const Task& task)
+    {
+        const std::uint32_t header[4] = { std::uint32_t(task.count), std::uint32_t(batch.N),
+                                          std::uint32_t(batch.numInequalities), std::uint32_t(batch.numEqualities) };
+
+        if(worker.written == worker.out.size())
+            worker.out.clear(), worker.written = 0;
+
+        const std::size_t start = worker.out.size();
+
+        worker.out.resize(start + sizeof(header) + std::size_t(task.count) * batch.N * sizeof(double));
+
+        std::memcpy(worker.out.data() + start, header, sizeof(header));
+
+        for(int k = 0; k < task.count; ++k)
+            std::memcpy(worker.out.data() + start + sizeof(header) + std::size_t(k) * batch.N * sizeof(double), batch[task.first + k], batch.N * sizeof(double));
+
+        if(worker.inFlight.empty())
+            expect(worker, batch, task);
+
+        worker.inFlight.push_back(task);
+    }
+
+    /// The next answer of 'worker' is for 'task'
+    void expect (Worker& worker, const Batch& batch, const Task& task)
+    {
+        worker.in.resize(std::size_t(task.count) * (1 + batch.numInequalities + batch.numEqualities) * sizeof(double));
+        worker.received = 0;
+        worker.deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout * task.count));
+    }
+
+
+    /// Writes as much of the requests as possible without blocking. Returns false if the worker is gone
+    bool write (Worker& worker)
+    {
+        const ssize_t n = ::send(worker.fd, worker.out.data() + worker.written, worker.out.size() - worker.written, MSG_DONTWAIT | help::noSignal);
+
+        if(n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        worker.written += std::size_t(n);
+
+        return true;
+    }
+
+    /** Reads every answer available without blocking, storing the values of the finished chunks in 'batch'. Returns
+      * false if the worker is gone or sent more than was asked.
+    */
+    bool read (Worker& worker, Batch& batch, int& pending)
+    {
+        while(true)
+        {
+            if(!worker.ready)
+            {
+                const ssize_t n = ::recv(worker.fd, worker.in.data() + worker.received, worker.in.size() - worker.received, MSG_DONTWAIT);
+
+                if(n < 0)
+                    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+                if(n == 0)
+                    return false;
+
+                worker.received += std::size_t(n);
+
+                if(worker.received < worker.in.size())
+                    continue;
+
+                if(!greeted(worker))
+                    return false;
+
+                worker.ready = true;
+                worker.received = 0;
+
+                numJoined++;
+
+                continue;
+            }
+
+            if(worker.inFlight.empty())    /// Anything here is either the end of the connection or not part of the protocol
+            {
+                char extra;
+
+                return ::recv(worker.fd, &extra, 1, MSG_DONTWAIT | MSG_PEEK) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            }
+
+            const ssize_t n = ::recv(worker.fd, worker.in.data() + worker.received, worker.in.size() - worker.received, MSG_DONTWAIT);
+
+            if(n < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+            if(n == 0)    /// The end of the connection
+                return false;
+
+            worker.received += std::size_t(n);
+
+            if(worker.received < worker.in.size())
+                continue;
+
+
+            const Task task = worker.inFlight.front();
+            const double* values = reinterpret_cast<const double*>(worker.in.data());
+            const int numValues = 1 + batch.numInequalities + batch.numEqualities;
+
+            for(int k = 0; k < task.count; ++k)
+                help::storeValues(batch, task.first + k, values + std::size_t(k) * numValues);
+
+            worker.inFlight.pop_front();
+            pending--;
+
+            if(!worker.inFlight.empty())
+                expect(worker, batch, worker.inFlight.front());
+        }
+    }
+
+
+    /** Closes the connection of 'worker', giving its chunks in flight to the other workers. The candidates of a
+      * chunk are given one by one, and a single candidate is given again only once. Then, it gets infinite values.
+    */
+    void drop (Worker& worker, Batch& batch, int& pending)
+    {
+        ::close(worker.fd);
+
+        if(!worker.ready)
+        {
+            numRejected++;
+            return;
+        }
+
+        numDropped++;
+
+        for(const Task& task : worker.inFlight)
+        {
+            pending--;
+
+            if(task.count > 1)
+            {
+                for(int k = task.count - 1; k >= 0; --k)
+                    tasks.push_back(Task{ task.first + k, 1, 0 });
+
+                pending += task.count;
+                numRequeued++;
+            }
+
+            else if(task.attempts + 1 < 2)
+            {
+                tasks.push_back(Task{ task.first, 1, task.attempts + 1 });
+
+                pending++;
+                numRequeued++;
+            }
+
+            else
+            {
+                numFailures++;
+
+                failed.assign(1 + batch.numInequalities + batch.numEqualities, std::numeric_limits<double>::infinity());
+
+                help::storeValues(batch, task.first, failed.data());
+            }
+        }
+    }
+
+#endif
+
+
+
+    int N;                 /// Sizes of the problem, sent in the hello
+    int numInequalities;
+    int numEqualities;
+
+    std::string token;     /// Expected in the answer to the hello
+
+    double timeout;   /// Seconds per candidate. Not used if not positive
+    int chunk;        /// Candidates per request. See the constructor
+    int depth;        /// Requests in flight for each worker
+
+    int listener = -1;
+    int listenPort = 0;
+
+    std::vector<Worker> workers;
+
+    std::vector<Task> tasks;          /// Chunks not given to any worker yet, the next one at the back
+    std::vector<pollfd> polls;        /// The listener, then the connections, waited for by 'progress'
+    std::vector<double> failed;       /// Values of a failed candidate
+
+    long numJoined = 0;
+    long numDropped = 0;
+    long numRequeued = 0;
+    long numFailures = 0;
+    long numRejected = 0;
+
+    std::mutex mutex;    /// Only one 'evaluate' at a time
+};
+
+
+
+#ifdef MDE_SUBPROCESS_POSIX
+
+/** Main loop of a worker, for a problem with 'N' variables, 'numInequalities' inequalities and 'numEqualities'
+  * equalities. Connects to the master at 'host' and 'port', trying again for up to 'retrySeconds', checks its hello
+  * and answers it with 'token', then answers its requests until it closes the connection. For each candidate, it
+  * calls:
+  *
+  * double f (const double* x, int N, double* inequalities, double* equalities)
+  *
+  * which returns the fitness and writes the constraints values. Returns 0 when the master closes the connection
+  * (also if it rejects the token), 1 if the hello or a request has other sizes or version, or a request is
+  * truncated or can't be answered, and 2 if it could not connect. An exception thrown by 'f'
+  * closes the connection (so the master gives its candidates to other workers) and is rethrown.
+*/
+template <class F>
+int serveTcp (const std::string& host, int port, int N, int numInequalities, int numEqualities, F f,
+              const std::string& token = "", double retrySeconds = 10.0)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(retrySeconds));
+
+    int fd = -1;
+
+    while(fd < 0)
+    {
+        addrinfo hints{};
+        addrinfo* addresses = nullptr;
+
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if(::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) == 0)
+        {
+            for(addrinfo* a = addresses; a && fd < 0; a = a->ai_next)
+            {
+                fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+
+                if(fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+                    ::close(fd), fd = -1;
+            }
+
+            ::freeaddrinfo(addresses);
+        }
+
+        if(fd < 0)
+        {
+            if(std::chrono::steady_clock::now() >= deadline)
+                return 2;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    const int yes = 1;
+
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+
+    std::uint32_t hello[5];
+
+    const bool greeted = ::recv(fd, hello, sizeof(hello), MSG_WAITALL) == ssize_t(sizeof(hello)) &&
+                         hello[0] == help::helloMagic && hello[1] == help::helloVersion && hello[2] == std::uint32_t(N) &&
+                         hello[3] == std::uint32_t(numInequalities) && hello[4] == std::uint32_t(numEqualities);
+
+    const std::uint32_t answer[3] = { help::helloMagic, help::helloVersion, std::uint32_t(token.size()) };
+
+    std::vector<char> message(reinterpret_cast<const char*>(answer), reinterpret_cast<const char*>(answer) + sizeof(answer));
+
+    message.insert(message.end(), token.begin(), token.end());
+
+    if(!greeted || ::send(fd, message.data(), message.size(), help::noSignal) != ssize_t(message.size()))
+    {
+        ::close(fd);
+        return 1;
+    }
+
+    int code;
+
+    try
+    {
+        code = help::serveRequests(fd, fd, f, N, numInequalities, numEqualities);
+    }
+
+    catch(...)
+    {
+        ::close(fd);
+        throw;
+    }
+
+    ::close(fd);
+
+    return code;
+}
+
+#endif
+
+} // namespace mde
+
+
+#endif // MDE_DISTRIBUTED_H
@@ -7,15 +7,60 @@
 #define MDE_FUNCTION_BASE_H
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <numeric>
+#include <cstddef>
+#include <future>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <assert.h>
   
 #include "Vector.h"
+#include "Kernels.h"
 
 
 namespace mde
 {
 
+/** A contiguous block of candidates, given to the optional 'evaluateBatch' function.
+  * The candidate 'k' starts at 'x + k * stride' and has 'N' variables. The function
+  * must write the fitness of the candidate 'k' at 'fitness[k]'. If the function has
+  * constraints, it also must write the values of its 'numInequalities' inequalities at
+  * 'inequalities + k * numInequalities' and the values of its 'numEqualities' equalities
+  * at 'equalities + k * numEqualities'. The violation is then calculated by 'SetValues', 
+  * exactly as in the single candidate case. Example:
+  *
+  * void evaluateBatch (mde::Batch& batch)
+  * {
+  *     for(int k = 0; k < batch.count; ++k)
+  *         batch.fitness[k] = myFunction(batch[k], batch.N);
+  * }
+*/
+struct Batch
+{
+    /// Pointer to the first variable of the candidate 'k'
+    const double* operator [] (int k) const { return x + std::ptrdiff_t(k) * stride; }
+
+
+    const double* x;   /// Variables of all the candidates
+    int count;         /// Number of candidates
+    int N;             /// Number of variables of each candidate
+    int stride;        /// Distance between two consecutive candidates
+
+    double* fitness;        /// 'count' fitness values
+    double* inequalities;   /// 'count * numInequalities' inequalities values
+    double* equalities;     /// 'count * numEqualities' equalities values
+
+    int numInequalities;   /// Number of inequalities of each candidate
+    int numEqualities;     /// Number of equalities of each candidate
+};
+
+
+
+
 /** Base 'mde::Function'. All user defined functions useed by MDE should inherit 
   * from this class. Here we defined the number of variables, the 'Vector' type
   * the lower and upper bounds, the optimal value for the function and dummy
@@ -28,7 +73,7 @@ namespace mde
 template<int NumVariables = 0>
 struct Function
 {
-    /// Vector type. If 'NumVariables' is given, it is a 'std::array'. Otherwise, it is a 'std::vector'
+    /// Vector type. If a small 'NumVariables' is given, it is a 'std::array'. Otherwise, it is a 'help::SmallVector'
     using Vector = help::Vector<NumVariables>;
 
 
@@ -84,6 +129,79 @@ struct Function
     }
 
 
+    /** Instead of 'operator()', 'inequalities' and 'equalities', you can define a single fused 
+      * function, which is useful if they share expensive computations:
+      *
+      * double evaluate (const Vector& x, double* inequalities, double* equalities)
+      *
+      * It returns the objective value and writes the values of the 'numInequalities' inequalities
+      * and 'numEqualities' equalities (see below) to the given buffers. It is detected automatically.
+    */
+
+
+    /** The 'operator()' may also take a cutoff value, given by MDE, as a second argument:
+      *
+      * double operator () (const Vector& x, double cutoff)
+      *
+      * If the objective value is known to be greater than or equal to 'cutoff' before the evaluation
+      * ends (a partial sum of non negative terms that already exceeds it, for example), the function
+      * can return right away any value greater than or equal to 'cutoff'. A candidate like this never
+      * wins the selection, so the inexact value is never used. Otherwise, the exact value must be
+      * returned. The cutoff may be infinite. It is detected automatically, and not used by the
+      * fused 'evaluate' or by 'evaluateBatch'.
+    */
+
+
+    /** If the objective can be updated when only a few variables change (a separable sum, for
+      * example), you can also define the incremental version of 'operator()':
+      *
+      * double evaluateDelta (const Vector& x, const double* parent, double parentFitness,
+      *                       const int* changed, int numChanged)
+      *
+      * 'x' differs from the 'N' values of 'parent', whose objective value is 'parentFitness', only at
+      * the 'numChanged' indices of 'changed' (in increasing order). It must return the objective
+      * value of 'x'. MDE calls it for a child that does not differ from its parent in every variable,
+      * which happens often with a small 'Cr'. The constraints are still evaluated as usual.
+    */
+
+
+    /** An objective that spends most of its time waiting (for a solver writing a file of results, or for a
+      * local service) can also be started without blocking:
+      *
+      * std::future<double> evaluateAsync (const Vector& x)
+      *
+      * It starts the evaluation of 'x' and returns a future of the objective value (or anything default
+      * constructible and movable with a 'get' returning it). MDE keeps many of them in flight at once, up
+      * to 'Parameters::maxInFlight', and 'x' stays alive until its 'get' returns. The constraints are still
+      * evaluated as usual, on the calling thread. The 'operator()' must still be defined (it may simply
+      * wait for 'evaluateAsync'), as it is used outside of the generations. Ignored with the fused 'evaluate'.
+    */
+
+
+    /** A single evaluation can also use the threads of MDE, for a reduction over a large data set (see
+      * 'mde::Dataset'), if the function defines:
+      *
+      * void usePool (mde::help::ThreadPool* pool)
+      *
+      * MDE calls it in 'initialize' with its pool ('nullptr' if 'Parameters::threads' is 1). A loop run
+      * on the pool while it evaluates many candidates at once runs on the calling thread, so the cores
+      * are never oversubscribed. If there are fewer parents than threads, MDE evaluates the candidates
+      * one at a time, so each evaluation takes the whole pool.
+    */
+
+
+    /** Instead of 'inequalities' and 'equalities', the constraints can be given one by one:
+      *
+      * double constraint (const Vector& x, int c)
+      *
+      * It returns the value of the constraint 'c', where the first 'numInequalities' are the
+      * inequalities and the next 'numEqualities' are the equalities. If 'constraintVariables'
+      * (see below) says which variables each constraint depends on, MDE only evaluates the
+      * constraints of a child that depend on a variable that differs from its parent. The others
+      * are copied from the values of the parent. It is detected automatically.
+    */
+
+
     /** If the number of variables is given by 'NumVariables', it is initalized here.
       * If you supply an 'N' either on your function or here, this value will be overrided.
       * If the number of variables is not given in anyway, you must give a proper value to
@@ -96,6 +214,19 @@ struct Function
     double optimal;
 
 
+    /** Number of inequalities and equalities. Only needed if you define the fused 'evaluate'
+      * or the 'evaluateBatch' function with constraints. See the 'mde::Batch' class.
+    */
+    int numInequalities = 0;
+    int numEqualities = 0;
+
+
+    /** The indices of the variables that each constraint depends on, for the 'constraint' function.
+      * A constraint with an empty list (or not in the list at all) depends on every variable.
+    */
+    std::vector<std::vector<int>> constraintVariables;
+
+
     /// Lower and upper bounds. Defaulted to '-1e8' and '1e8' to avoid loss of precision.
     Vector lowerBounds;
     Vector upperBounds;
@@ -104,7 +235,75 @@ struct Function
 
 
 
-/** The above class is meant for inheritance on the user defined function. This one
+namespace help
+{
+
+class ThreadPool;
+
+
+/** Counter that can be incremented from many threads at once. Unlike 'std::atomic', it
+  * can be copied (the copy starts with the same value), so it can be a member of a function.
+*/
+class Counter
+{
+public:
+
+    Counter (long value = 0) : value(value) {}
+
+    Counter (const Counter& c) : value(c.load()) {}
+
+    Counter& operator = (const Counter& c)
+    {
+        value.store(c.load(), std::memory_order_relaxed);
+
+        return *this;
+    }
+
+
+    long operator ++ (int) { return value.fetch_add(1, std::memory_order_relaxed); }
+
+    Counter& operator += (long n)
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+
+        return *this;
+    }
+
+
+    long load () const { return value.load(std::memory_order_relaxed); }
+
+    operator long () const { return load(); }
+
+
+private:
+
+    std::atomic<long> value;
+};
+
+} // namespace help
+
+
+
+/** Temporaries used by 'SetValues' to call the user function. As the function may be called
+  * from many threads at once, each thread must use its own 'Workspace'. Nothing is allocated
+  * once the buffers have the correct capacity.
+*/
+struct Workspace
+{
+    std::vector<double> values;         /// Copy of the variables, if the function takes a 'std::vector'
+
+    std::vector<double> inequalities;   /// Constraints values, written by the fused 'evaluate' function
+    std::vector<double> equalities;
+
+    std::vector<double> constraints;   /// All constraints values, written by the 'constraint' function
+
+    std::vector<unsigned> marks;   /// 'marks[c] == stamp' if the constraint 'c' was already evaluated for this candidate
+    unsigned stamp = 0;
+};
+
+
+
+/** The 'Function' class is meant for inheritance on the user defined function. This one
   * inherits from the user function, adding the interface used by MDE. It defines
   * a single function, the 'operator()', that takes a 'Vector' as reference and sets
   * both its fitness and violation, based on the functions given by the user.
@@ -133,18 +332,501 @@ public:
     */
     double operator () (Vector& x)
     {
-        x.fitness = Func::operator()(x);
+        static thread_local Workspace workspace;
 
-        x.violation = inequalitiesValue(x) + equalitiesValue(x);
+        return operator()(x, workspace);
+    }
+
+    /** Same as above, using the temporaries of 'workspace'. If the user 'operator()' takes a 'const std::vector<double>&'
+      * instead of a 'Vector', the values are copied to 'workspace.values' before the call. If the user function defines
+      * the fused 'evaluate' function, it is called only once, and the constraints values are written to 'workspace'.
+    */
+    double operator () (Vector& x, Workspace& workspace)
+    {
+        single(x, workspace, std::numeric_limits<double>::infinity());
+
+        return x.fitness;
+    }
+
+    /** Same as above, giving the 'cutoff' to the user 'operator()', if it takes one. The fitness returned
+      * may be inexact if it is greater than or equal to 'cutoff' (see 'mde::Function').
+    */
+    double operator () (Vector& x, Workspace& workspace, double cutoff)
+    {
+        single(x, workspace, cutoff);
+
+        return x.fitness;
+    }
+
+
+    /** The two halves of the evaluation above, for the constraint-first lazy evaluation of MDE. 'setViolation'
+      * only calls the constraints functions and 'setFitness' only calls the 'operator()' of the user function.
+      * If the objective and the constraints are not separate functions (see 'hasSeparateConstraints'), both
+      * do the complete evaluation.
+    */
+    double setViolation (Vector& x, Workspace& workspace)
+    {
+        violationOnly(x, workspace);
+
+        return x.violation;
+    }
+
+    double setFitness (Vector& x, Workspace& workspace, double cutoff = std::numeric_limits<double>::infinity())
+    {
+        fitnessOnly(x, workspace, cutoff);
+
+        return x.fitness;
+    }
+
+
+    /** Incremental versions of the two functions above, for a child 'x' that differs from its parent only at the
+      * 'numChanged' indices in 'changed'. If 'hasDelta' is true, 'setFitness' calls the user 'evaluateDelta' with
+      * the variables and the fitness of the parent. If 'hasSparseConstraints' is true, 'setViolation' copies the
+      * 'parentValues' of the constraints to 'values' and only evaluates the constraints that depend on a changed
+      * variable. Otherwise, they are the same as the complete versions. 'setDependencies' must be called first.
+    */
+    double setFitness (Vector& x, Workspace& workspace, const double* parent, double parentFitness,
+                       const int* changed, int numChanged)
+    {
+        fitnessDelta(x, workspace, parent, parentFitness, changed, numChanged);
 
         return x.fitness;
     }
 
+    double setViolation (Vector& x, Workspace& workspace, const double* parentValues, double* values,
+                         const int* changed, int numChanged)
+    {
+        violationDelta(x, workspace, parentValues, values, changed, numChanged);
+
+        return x.violation;
+    }
+
+
+    /** Starts the evaluation of 'x' and returns a future of its fitness. The violation is set right away. If 'hasAsync'
+      * is true, the objective is given to the user 'evaluateAsync', and 'x' must be kept alive until the future is ready.
+      * Otherwise, everything is evaluated right away and the future is already ready.
+    */
+    auto launch (Vector& x, Workspace& workspace)
+    {
+        return launchImpl(x, workspace);
+    }
+
+
+    /// Gives the pool of MDE to the user function, if it defines 'usePool'. See 'mde::Function'
+    void setPool (help::ThreadPool* pool)
+    {
+        givePool(pool);
+    }
+
+
+    /** Builds, for each of the 'N' variables, the list of constraints that depend on it, from the 'constraintVariables'
+      * of the user function. The constraints without a list are always evaluated.
+    */
+    void setDependencies (int N)
+    {
+        const int numConstraints = Func::numInequalities + Func::numEqualities;
+
+        dependents.assign(N + 1, 0);
+        alwaysEvaluated.clear();
+
+        for(int c = 0; c < numConstraints; ++c)
+        {
+            if(c >= int(Func::constraintVariables.size()) || Func::constraintVariables[c].empty())
+                alwaysEvaluated.push_back(c);
+
+            else for(int j : Func::constraintVariables[c])
+            {
+                assert(j >= 0 && j < N && "Invalid variable in 'constraintVariables'");
+                dependents[j + 1]++;
+            }
+        }
+
+        std::partial_sum(dependents.begin(), dependents.end(), dependents.begin());
+
+        dependentConstraints.resize(dependents[N]);
+
+        std::vector<int> position(dependents.begin(), dependents.end() - 1);
+
+        for(int c = 0; c < int(Func::constraintVariables.size()) && c < numConstraints; ++c)
+            for(int j : Func::constraintVariables[c])
+                dependentConstraints[position[j]++] = c;
+    }
+
+
+    /** Evaluates a whole block of candidates, setting the fitness values in 'batch.fitness' 
+      * and the violation values in 'violation'. The buffers for the constraints values in
+      * 'batch' must be given by the caller. If the user function defines the 'evaluateBatch'
+      * function, it is called only once for the entire block. Otherwise, the 'operator()'
+      * above is called for each candidate.
+    */
+    void operator () (Batch& batch, double* violation)
+    {
+        evaluateBatch(batch, violation);
+    }
+
+
+    /// Returns true if the user function defines 'evaluateBatch'
+    static constexpr bool hasBatch ()
+    {
+        return decltype(hasBatchImpl<Func>(0))::value;
+    }
+
+    /// Returns true if the user function defines the fused 'evaluate'
+    static constexpr bool hasFused ()
+    {
+        return decltype(hasFusedImpl<Func>(0))::value;
+    }
+
+    /// Returns true if the user 'operator()' takes a cutoff value
+    static constexpr bool hasCutoff ()
+    {
+        return decltype(hasCutoffImpl<Func>(0))::value;
+    }
+
+    /// Returns true if the user function defines 'evaluateDelta' (ignored with the fused 'evaluate')
+    static constexpr bool hasDelta ()
+    {
+        return decltype(hasDeltaImpl<Func>(0))::value && !hasFused();
+    }
+
+    /// Returns true if the user function defines the 'constraint' function (ignored with the fused 'evaluate')
+    static constexpr bool hasSparseConstraints ()
+    {
+        return decltype(hasSparseImpl<Func>(0))::value && !hasFused();
+    }
+
+    /// Returns true if the user function defines 'evaluateAsync' (ignored with the fused 'evaluate')
+    static constexpr bool hasAsync ()
+    {
+        return decltype(hasAsyncImpl<Func>(0))::value && !hasFused();
+    }
+
+    /// Returns true if the user function defines 'usePool'
+    static constexpr bool hasPool ()
+    {
+        return decltype(hasPoolImpl<Func>(0))::value;
+    }
+
+    /// Returns true if the objective can be evaluated apart from the constraints
+    static constexpr bool hasSeparateConstraints ()
+    {
+        return !hasFused();
+    }
+
 
 
 private:
 
 
+    /// 'Vector' without the conversion to 'std::vector'. Only used to detect what the user function takes
+    struct Exact : Vector
+    {
+        operator std::vector<double> () const = delete;
+    };
+
+    /// Detection of a 'Func::operator()' taking a 'Vector' (or anything it binds to without a copy), followed by 'Args'
+    template <class F, class... Args>
+    static auto takesVectorImpl (int) -> decltype(std::declval<F&>()(std::declval<const Exact&>(), std::declval<Args>()...), std::true_type{});
+
+    template <class F, class...>
+    static std::false_type takesVectorImpl (...);
+
+    /// Detection of the 'Func::operator()' taking a cutoff value
+    template <class F>
+    static auto hasCutoffImpl (int) -> decltype(double(std::declval<F&>()(std::declval<const Vector&>(), 0.0)), std::true_type{});
+
+    template <class F>
+    static std::false_type hasCutoffImpl (...);
+
+
+    /// The user function takes a 'Vector', so it is given directly. 'args' is empty or the cutoff value
+    template <class F = Func, class... Args, std::enable_if_t<decltype(takesVectorImpl<F, Args...>(0))::value, int> = 0>
+    double objective (const Vector& x, Workspace&, Args... args)
+    {
+        return Func::operator()(x, args...);
+    }
+
+    /** The user function takes a 'const std::vector<double>&'. Instead of converting (and allocating)
+      * at every call, the values are copied to a buffer that is reused.
+    */
+    template <class F = Func, class... Args, std::enable_if_t<!decltype(takesVectorImpl<F, Args...>(0))::value, int> = 0>
+    double objective (const Vector& x, Workspace& workspace, Args... args)
+    {
+        workspace.values.assign(x.begin(), x.end());
+
+        return Func::operator()(workspace.values, args...);
+    }
+
+
+    /// Gives the cutoff only if the user function takes it
+    template <class F = Func, std::enable_if_t<decltype(hasCutoffImpl<F>(0))::value, int> = 0>
+    double objectiveCutoff (const Vector& x, Workspace& workspace, double cutoff)
+    {
+        return objective(x, workspace, cutoff);
+    }
+
+    template <class F = Func, std::enable_if_t<!decltype(hasCutoffImpl<F>(0))::value, int> = 0>
+    double objectiveCutoff (const Vector& x, Workspace& workspace, double)
+    {
+        return objective(x, workspace);
+    }
+
+
+
+    /// Detection of the fused 'Func::evaluate (const Vector&, double* inequalities, double* equalities)'
+    template <class F>
+    static auto hasFusedImpl (int) -> decltype(double(std::declval<F&>().evaluate(std::declval<const Vector&>(), 
+                                                                                   std::declval<double*>(), std::declval<double*>())), std::true_type{});
+
+    template <class F>
+    static std::false_type hasFusedImpl (...);
+
+    /// Detection of the per constraint 'Func::constraint (const Vector&, int)'
+    template <class F>
+    static auto hasSparseImpl (int) -> decltype(double(std::declval<F&>().constraint(std::declval<const Vector&>(), 0)), std::true_type{});
+
+    template <class F>
+    static std::false_type hasSparseImpl (...);
+
+
+    /** Fused evaluation. The objective and all the constraints values are computed in a single call,
+      * and the violation is reduced from the values written to the buffers of 'workspace'.
+    */
+    template <class F = Func, std::enable_if_t<decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void single (Vector& x, Workspace& workspace, double)
+    {
+        workspace.inequalities.resize(Func::numInequalities);
+        workspace.equalities.resize(Func::numEqualities);
+
+        x.fitness = Func::evaluate(x, workspace.inequalities.data(), workspace.equalities.data());
+
+        x.violation = inequalitiesValue(workspace.inequalities.data(), Func::numInequalities) +
+                      equalitiesValue(workspace.equalities.data(), Func::numEqualities);
+    }
+
+    /// Separate calls for the objective, the inequalities and the equalities
+    template <class F = Func, std::enable_if_t<!decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void single (Vector& x, Workspace& workspace, double cutoff)
+    {
+        fitnessOnly(x, workspace, cutoff);
+        violationOnly(x, workspace);
+    }
+
+
+    /// Only the objective or only the constraints. See 'setFitness' and 'setViolation'
+    template <class F = Func, std::enable_if_t<!decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void fitnessOnly (Vector& x, Workspace& workspace, double cutoff)
+    {
+        x.fitness = objectiveCutoff(x, workspace, cutoff);
+    }
+
+    template <class F = Func, std::enable_if_t<!decltype(hasFusedImpl<F>(0))::value && !decltype(hasSparseImpl<F>(0))::value, int> = 0>
+    void violationOnly (Vector& x, Workspace&)
+    {
+        x.violation = inequalitiesValue(x) + equalitiesValue(x);
+    }
+
+    /// Every constraint is evaluated one by one, and the values are kept in 'workspace.constraints'
+    template <class F = Func, std::enable_if_t<!decltype(hasFusedImpl<F>(0))::value && decltype(hasSparseImpl<F>(0))::value, int> = 0>
+    void violationOnly (Vector& x, Workspace& workspace)
+    {
+        workspace.constraints.resize(Func::numInequalities + Func::numEqualities);
+
+        for(int c = 0; c < int(workspace.constraints.size()); ++c)
+            workspace.constraints[c] = Func::constraint(x, c);
+
+        x.violation = constraintsValue(workspace.constraints.data());
+    }
+
+    /// With the fused function, both need the complete evaluation
+    template <class F = Func, std::enable_if_t<decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void fitnessOnly (Vector& x, Workspace& workspace, double cutoff)
+    {
+        single(x, workspace, cutoff);
+    }
+
+    template <class F = Func, std::enable_if_t<decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void violationOnly (Vector& x, Workspace& workspace)
+    {
+        single(x, workspace, std::numeric_limits<double>::infinity());
+    }
+
+
+
+    /// Detection of 'Func::evaluateDelta'
+    template <class F>
+    static auto hasDeltaImpl (int) -> decltype(double(std::declval<F&>().evaluateDelta(std::declval<const Vector&>(), std::declval<const double*>(), 
+                                                                                        0.0, std::declval<const int*>(), 0)), std::true_type{});
+
+    template <class F>
+    static std::false_type hasDeltaImpl (...);
+
+
+    /// Incremental objective. See 'hasDelta'
+    template <class F = Func, std::enable_if_t<decltype(hasDeltaImpl<F>(0))::value && !decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void fitnessDelta (Vector& x, Workspace&, const double* parent, double parentFitness, const int* changed, int numChanged)
+    {
+        x.fitness = Func::evaluateDelta(x, parent, parentFitness, changed, numChanged);
+    }
+
+    template <class F = Func, std::enable_if_t<!(decltype(hasDeltaImpl<F>(0))::value && !decltype(hasFusedImpl<F>(0))::value), int> = 0>
+    void fitnessDelta (Vector& x, Workspace& workspace, const double*, double, const int*, int)
+    {
+        fitnessOnly(x, workspace, std::numeric_limits<double>::infinity());
+    }
+
+
+    /// Detection of 'Func::evaluateAsync', returning anything with a 'get' that gives the objective value
+    template <class F>
+    static auto hasAsyncImpl (int) -> decltype(double(std::declval<F&>().evaluateAsync(std::declval<const Vector&>()).get()), std::true_type{});
+
+    template <class F>
+    static std::false_type hasAsyncImpl (...);
+
+
+    /// The constraints are evaluated now and the objective is left to the user function. See 'launch'
+    template <class F = Func, std::enable_if_t<decltype(hasAsyncImpl<F>(0))::value && !decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    auto launchImpl (Vector& x, Workspace& workspace)
+    {
+        violationOnly(x, workspace);
+
+        return Func::evaluateAsync(x);
+    }
+
+    template <class F = Func, std::enable_if_t<!(decltype(hasAsyncImpl<F>(0))::value && !decltype(hasFusedImpl<F>(0))::value), int> = 0>
+    std::future<double> launchImpl (Vector& x, Workspace& workspace)
+    {
+        single(x, workspace, std::numeric_limits<double>::infinity());
+
+        std::promise<double> ready;
+
+        ready.set_value(x.fitness);
+
+        return ready.get_future();
+    }
+
+
+    /** Incremental constraints. Only the constraints that depend on a changed variable are evaluated (each
+      * one once, using the marks of 'workspace'), along with the ones that depend on every variable.
+    */
+    template <class F = Func, std::enable_if_t<decltype(hasSparseImpl<F>(0))::value && !decltype(hasFusedImpl<F>(0))::value, int> = 0>
+    void violationDelta (Vector& x, Workspace& workspace, const double* parentValues, double* values, const int* changed, int numChanged)
+    {
+        const int numConstraints = Func::numInequalities + Func::numEqualities;
+
+        std::copy(parentValues, parentValues + numConstraints, values);
+
+        workspace.marks.resize(numConstraints);
+
+        if(++workspace.stamp == 0)    /// The stamp wrapped around, so the old marks are not valid anymore
+        {
+            std::fill(workspace.marks.begin(), workspace.marks.end(), 0);
+            workspace.stamp = 1;
+        }
+
+        for(int c : alwaysEvaluated)
+            values[c] = Func::constraint(x, c);
+
+        for(int k = 0; k < numChanged; ++k)
+        {
+            for(int d = dependents[changed[k]]; d < dependents[changed[k] + 1]; ++d)
+            {
+                const int c = dependentConstraints[d];
+
+                if(workspace.marks[c] != workspace.stamp)
+                {
+                    workspace.marks[c] = workspace.stamp;
+                    values[c] = Func::constraint(x, c);
+                }
+            }
+        }
+
+        x.violation = constraintsValue(values);
+    }
+
+    template <class F = Func, std::enable_if_t<!(decltype(hasSparseImpl<F>(0))::value && !decltype(hasFusedImpl<F>(0))::value), int> = 0>
+    void violationDelta (Vector& x, Workspace& workspace, const double*, double*, const int*, int)
+    {
+        violationOnly(x, workspace);
+    }
+
+
+    /// Violation from the values of all the constraints, the inequalities first
+    double constraintsValue (const double* values) const
+    {
+        return inequalitiesValue(values, Func::numInequalities) + equalitiesValue(values + Func::numInequalities, Func::numEqualities);
+    }
+
+
+
+    /// Detection of 'Func::usePool'
+    template <class F>
+    static auto hasPoolImpl (int) -> decltype(std::declval<F&>().usePool(std::declval<help::ThreadPool*>()), std::true_type{});
+
+    template <class F>
+    static std::false_type hasPoolImpl (...);
+
+    template <class F = Func, std::enable_if_t<decltype(hasPoolImpl<F>(0))::value, int> = 0>
+    void givePool (help::ThreadPool* pool)
+    {
+        Func::usePool(pool);
+    }
+
+    template <class F = Func, std::enable_if_t<!decltype(hasPoolImpl<F>(0))::value, int> = 0>
+    void givePool (help::ThreadPool*) {}
+
+
+
+    /// Detection of 'Func::evaluateBatch'
+    template <class F>
+    static auto hasBatchImpl (int) -> decltype(std::declval<F&>().evaluateBatch(std::declval<Batch&>()), std::true_type{});
+
+    template <class F>
+    static std::false_type hasBatchImpl (...);
+
+
+    /** If the user function has a 'evaluateBatch' function, we call it only once and calculate the
+      * violation of each candidate from the values of the constraints, as in the single candidate case.
+    */
+    template <class F = Func, std::enable_if_t<decltype(hasBatchImpl<F>(0))::value, int> = 0>
+    void evaluateBatch (Batch& batch, double* violation)
+    {
+        Func::evaluateBatch(batch);
+
+        for(int k = 0; k < batch.count; ++k)
+            violation[k] = inequalitiesValue(batch.inequalities + std::ptrdiff_t(k) * batch.numInequalities, batch.numInequalities) +
+                           equalitiesValue(batch.equalities + std::ptrdiff_t(k) * batch.numEqualities, batch.numEqualities);
+    }
+
+    /// Otherwise, each candidate is copied to a 'Vector' and evaluated alone
+    template <class F = Func, std::enable_if_t<!decltype(hasBatchImpl<F>(0))::value, int> = 0>
+    void evaluateBatch (Batch& batch, double* violation)
+    {
+        Vector x(batch.N);
+
+        for(int k = 0; k < batch.count; ++k)
+        {
+            std::copy(batch[k], batch[k] + batch.N, x.begin());
+
+            batch.fitness[k] = operator()(x);
+            violation[k] = x.violation;
+        }
+    }
+
+
+    /// Sum of the penalties of 'n' inequalities values, using SIMD instructions. See below
+    double inequalitiesValue (const double* ineqs, int n) const
+    {
+        return help::inequalityPenalty(ineqs, n, simd);
+    }
+
+    /// Sum of the penalties of 'n' equalities values, using SIMD instructions. See below
+    double equalitiesValue (const double* eqs, int n) const
+    {
+        return help::equalityPenalty(eqs, n, eqTol, simd);
+    }
+
+
     /** If the function provided by the user has equalities or inequalities constraints,
       * you can define them to return either a float or double value, or an iterable
       * container (with 'std::begin' and 'std::end' defined) containing the values of
@@ -222,6 +904,18 @@ private:
 
     /// Tolerance parameter for equality constraints
     double eqTol;
+
+    /// Instruction set used by the penalty kernels
+    help::SimdLevel simd = help::simdLevel();
+
+
+    /** Constraints that depend on each variable, built by 'setDependencies'. The constraints that depend
+      * on the variable 'j' are at the positions [dependents[j], dependents[j + 1]) of 'dependentConstraints'.
+    */
+    std::vector<int> dependents;
+    std::vector<int> dependentConstraints;
+
+    std::vector<int> alwaysEvaluated;   /// Constraints that depend on every variable
 };
 
 } // namespace mde
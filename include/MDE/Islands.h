@@ -0,0 +1,396 @@
+/** \file Islands.h
+  *
+  * Island model. Many 'MDE' populations (the islands) run at once, each one on
+  * its own thread and with its own 'Parameters', so they can use different bounds
+  * handling, 'Fa', 'Cr' and so on. Every 'interval' generations, each island sends
+  * copies of its best individuals to other islands, that replace their worst
+  * ones with the received individuals that are better. The individuals travel
+  * through lock-free queues, one for each pair of islands, so no island ever
+  * waits for another. Which islands receive them is given by the topology: the
+  * next island ('Ring'), a random one ('Random') or every other ('Full'). Example:
+  *
+  * std::vector<mde::Parameters> params(4);    // Four islands
+  *
+  * params[1].bndHandle = "reflection";
+  * params[2].Cr = 0.5;
+  *
+  * mde::Migration migration;
+  *
+  * migration.topology = mde::Migration::Full;
+  * migration.interval = 20;
+  *
+  * mde::Islands<Function> islands(params, migration);
+  *
+  * auto best = islands();    // Best of every island
+  *
+  * for(const auto& s : islands.statistics())
+  *     std::cout << s.generations << "  " << s.accepted << "  " << s.fitness << "\n";
+  *
+  * The islands run until they reach their 'maxIter' or until any of them converges.
+  * The results depend on the timing of the threads, so they are not reproducible.
+*/
+
+#ifndef MDE_ISLANDS_H
+#define MDE_ISLANDS_H
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "MDE.h"
+
+
+namespace mde
+{
+
+/// How the islands exchange their individuals. See 'Islands'
+struct Migration
+{
+    enum Topology
+    {
+        Ring,      /// Each island sends to the next one
+        Random,    /// Each island sends to another one, chosen at random at every migration
+        Full       /// Each island sends to every other
+    };
+
+    Topology topology = Ring;
+
+    int interval = 50;   /// Number of generations between two migrations of each island
+
+    int elites = 2;      /// Number of the best individuals sent at each migration
+
+    int capacity = 0;    /// Individuals that can wait in each queue. With 0, four migrations. If it is full, they are dropped
+};
+
+
+/// What happened in an island during the last run. See 'Islands::statistics'
+struct IslandStatistics
+{
+    int generations = 0;     /// Generations done
+    long evaluations = 0;    /// Function evaluations, including the initial population
+
+    long emigrants = 0;      /// Individuals sent
+    long dropped = 0;        /// Individuals not sent because the queue was full
+    long immigrants = 0;     /// Individuals received
+    long accepted = 0;       /// Individuals received that replaced one of the island
+
+    double fitness = 0.0;    /// Fitness and violation of the best individual of the island
+    double violation = 0.0;
+
+    double seconds = 0.0;    /// Time spent by the island
+};
+
+
+
+namespace help
+{
+
+/** A queue of individuals with a single producer and a single consumer, that never blocks. The individuals
+  * are kept in the rows of a 'Population', including their constraints values. Nothing is allocated after
+  * the construction.
+*/
+class MigrationQueue
+{
+public:
+
+    MigrationQueue (int capacity, int N, int numConstraints) : rows(capacity, N, numConstraints) {}
+
+
+    /// Copies the row 'i' of 'pop' to the end of the queue. Returns false if the queue is full. Only called by the producer
+    bool push (const Population& pop, int i)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+
+        if(t - head.load(std::memory_order_acquire) == std::size_t(rows.size()))
+            return false;
+
+        rows.assign(int(t % rows.size()), pop, i);
+
+        tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Moves the first individual of the queue to the row 'i' of 'pop'. Returns false if it is empty. Only called by the consumer
+    bool pop (Population& pop, int i)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+
+        if(h == tail.load(std::memory_order_acquire))
+            return false;
+
+        pop.assign(i, rows, int(h % rows.size()));
+
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+
+private:
+
+    Population rows;   /// The slots of the queue
+
+    std::atomic<std::size_t> head{0};   /// Next individual to be taken
+
+    char padding[64];                   /// So 'head' and 'tail' are not in the same cache line
+
+    std::atomic<std::size_t> tail{0};   /// Next free slot
+};
+
+
+
+
+/** Sends copies of the 'migration.elites' best individuals of 'island', the island 'k' of 'K', to the islands given
+  * by the topology. The individuals for the island 'j' are pushed to 'queue(k, j)'. Used by 'Islands' and by
+  * 'ProcessIsland'.
+*/
+template <class Island, class QueueOf>
+void emigrate (Island& island, int k, int K, const Migration& migration, IslandStatistics& s, QueueOf queue)
+{
+    int targets[1];
+
+    if(migration.topology == Migration::Random)
+        island.workers[0].randInt.distinct(K, k, targets, 1);
+
+    const std::vector<int>& order = island.rank();
+
+    for(int e = 0; e < std::min(migration.elites, int(order.size())); ++e)
+    {
+        for(int to = 0; to < K; ++to)
+        {
+            const bool target = migration.topology == Migration::Full ? to != k :
+                                migration.topology == Migration::Ring ? to == (k + 1) % K : to == targets[0];
+
+            if(!target)
+                continue;
+
+            if(queue(k, to).push(island.population, order[e]))
+                s.emigrants++;
+
+            else
+                s.dropped++;
+        }
+    }
+}
+
+
+/** Takes every individual waiting in the queues 'queue(j, k)' of 'island', the island 'k' of 'K', using the row of
+  * 'arrival'. Each one replaces the worst individual of the island not replaced yet, if it is better (using MDE
+  * comparison). The best individual of the island is never replaced. Returns true if convergence is reached.
+*/
+template <class Island, class QueueOf>
+bool immigrate (Island& island, int k, int K, Population& arrival, IslandStatistics& s, QueueOf queue)
+{
+    Population& pop = island.population;
+
+    const std::vector<int>& order = island.rank();
+
+    int worst = int(order.size()) - 1;
+
+    for(int from = 0; from < K; ++from)
+    {
+        if(from == k)
+            continue;
+
+        while(queue(from, k).pop(arrival, 0))
+        {
+            s.immigrants++;
+
+            const double fitness = arrival.fitness[0];
+            const double violation = arrival.violation[0];
+
+            if(worst > 0 && better(fitness, violation, pop.fitness[order[worst]], pop.violation[order[worst]]))
+            {
+                pop.assign(order[worst--], arrival, 0);
+
+                s.accepted++;
+
+                if(better(fitness, violation, island.best.fitness, island.best.violation))
+                    island.setBest(arrival[0], fitness, violation);
+
+                if(island.converged(fitness, violation))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+} // namespace help
+
+
+
+
+template <class FunctionType, class BoundsPolicy = bounds::Runtime>
+class Islands
+{
+public:
+
+    using Island     = MDE<FunctionType, BoundsPolicy>;   /// Each island is a complete 'MDE'
+    using Vector     = typename Island::Vector;
+    using Population = help::Population;
+
+
+    /// One island for each element of 'params', all of them with a copy of 'function'
+    Islands (const std::vector<Parameters>& params, const Migration& migration = Migration(),
+             const FunctionType& function = FunctionType()) : params(params), migration(migration)
+    {
+        assert(!params.empty() && "No islands???");
+
+        for(const auto& p : params)
+            islands.emplace_back(new Island(p, function));
+
+        initialize();
+    }
+
+    /// 'numIslands' islands with the same parameters
+    Islands (int numIslands, const Parameters& params = Parameters(), const Migration& migration = Migration(),
+             const FunctionType& function = FunctionType()) : Islands(std::vector<Parameters>(numIslands, params), migration, function) {}
+
+
+
+    /** Runs every island on its own thread, until they reach their 'maxIter' or any of them converges. Returns the
+      * best individual of all the islands. An exception thrown by an island stops the others, and is rethrown here.
+    */
+    Vector operator () ()
+    {
+        const int K = size();
+
+        stop = false;
+
+        std::vector<std::exception_ptr> errors(K);
+        std::vector<std::thread> threads;
+
+        for(int k = 0; k < K; ++k)
+            threads.emplace_back([this, k, &errors]
+            {
+                try
+                {
+                    run(k);
+                }
+
+                catch(...)
+                {
+                    errors[k] = std::current_exception();
+                    stop = true;
+                }
+            });
+
+        for(auto& t : threads)
+            t.join();
+
+        for(auto& error : errors)
+            if(error)
+                std::rethrow_exception(error);
+
+
+        int b = 0;
+
+        for(int k = 1; k < K; ++k)
+            if(help::better(stats[k].fitness, stats[k].violation, stats[b].fitness, stats[b].violation))
+                b = k;
+
+        return islands[b]->result();
+    }
+
+
+
+    /// Statistics of each island during the last run
+    const std::vector<IslandStatistics>& statistics () const { return stats; }
+
+    /// The island 'k'
+    Island& island (int k) { return *islands[k]; }
+
+    /// Number of islands
+    int size () const { return int(islands.size()); }
+
+
+
+    /// Creates the queues and the buffers used by the migration. Called by the constructor
+    void initialize ()
+    {
+        const int K = size();
+        const int N = islands[0]->population.cols();
+        const int numConstraints = islands[0]->population.numConstraints();
+
+        const int capacity = migration.capacity > 0 ? migration.capacity : 4 * migration.elites;
+
+        queues.clear();
+
+        for(int from = 0; from < K; ++from)
+            for(int to = 0; to < K; ++to)
+                queues.emplace_back(from == to ? nullptr : new help::MigrationQueue(std::max(1, capacity), N, numConstraints));
+
+        arrivals.assign(K, Population(1, N, numConstraints));
+
+        stats.assign(K, IslandStatistics());
+    }
+
+
+
+private:
+
+    /// Main loop of the island 'k'
+    void run (int k)
+    {
+        Island& island = *islands[k];
+        IslandStatistics& s = stats[k];
+
+        const auto start = std::chrono::steady_clock::now();
+
+        s = IslandStatistics();
+
+        bool done = island.converged(island.best);
+
+        for(int iter = 1; !done && iter <= params[k].maxIter && !stop.load(std::memory_order_relaxed); ++iter)
+        {
+            done = island.generation(iter);
+
+            s.generations++;
+
+            if(!done && size() > 1 && iter % migration.interval == 0)
+            {
+                auto queue = [this](int from, int to) -> help::MigrationQueue& { return *queues[from * size() + to]; };
+
+                help::emigrate(island, k, size(), migration, s, queue);
+
+                done = help::immigrate(island, k, size(), arrivals[k], s, queue);
+            }
+        }
+
+        if(done)
+            stop = true;
+
+        const Vector& best = island.result();
+
+        s.evaluations = island.evaluations();
+        s.fitness = best.fitness;
+        s.violation = best.violation;
+        s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+
+    std::vector<Parameters> params;   /// Parameters of each island
+
+    Migration migration;
+
+    std::vector<std::unique_ptr<Island>> islands;
+
+    std::vector<std::unique_ptr<help::MigrationQueue>> queues;   /// The queue from the island 'i' to the island 'j' is at 'i * size() + j'
+
+    std::vector<Population> arrivals;   /// Where each island receives an individual
+
+    std::vector<IslandStatistics> stats;
+
+    std::atomic<bool> stop{false};   /// Set when any island converges or throws
+};
+
+} // namespace mde
+
+
+#endif // MDE_ISLANDS_H
@@ -0,0 +1,676 @@
+/** \file Kernels.h
+  *
+  * SIMD versions of the hot loops of MDE: the mutation and the bounds handling.
+  * Each kernel has a scalar version, an AVX2 version and an AVX-512 version. The
+  * best one supported by the processor is chosen at runtime, only once, so the
+  * library can be compiled without any special flag and still use the widest
+  * instructions available. If you want to use only the scalar versions, define
+  * 'MDE_NO_SIMD' before including any MDE header.
+  *
+  * All the versions use the same operations in the same order, so they only
+  * differ in the last bits if the compiler decides to fuse some multiply-add.
+*/
+
+#ifndef MDE_KERNELS_H
+#define MDE_KERNELS_H
+
+#if !defined(MDE_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define MDE_SIMD_X86 1
+    #include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace mde
+{
+
+namespace help
+{
+
+/// The instruction sets with a specialized kernel
+enum class SimdLevel { Scalar, AVX2, AVX512 };
+
+
+/// The widest instruction set supported by the processor. Only checked once
+inline SimdLevel simdLevel ()
+{
+#ifdef MDE_SIMD_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx512f") ? SimdLevel::AVX512 :
+                                   __builtin_cpu_supports("avx2")    ? SimdLevel::AVX2   : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+
+
+/** Parameters of the modified differential mutation kernel. For every 'j' in [0, N):
+  *
+  * child[j] = (u[j] < Cr) ? x3[j] + Fa * (best[j] - x2[j]) + Fb * (parent[j] - x1[j]) : parent[j]
+  *
+  * where 'u' holds 'N' uniform random numbers in [0, 1). So the crossover mask
+  * is computed in bulk and the mutation is a blend of two vector expressions.
+*/
+struct MutationArgs
+{
+    double* child;
+    const double* x1;
+    const double* x2;
+    const double* x3;
+    const double* best;
+    const double* parent;
+    const double* u;
+
+    double Cr;
+    double Fa;
+    double Fb;
+
+    int N;
+};
+
+
+/// The mutated value of the component 'j', without crossover
+inline double mutated (const MutationArgs& a, int j)
+{
+    return a.x3[j] + a.Fa * (a.best[j] - a.x2[j]) + a.Fb * (a.parent[j] - a.x1[j]);
+}
+
+
+/// Scalar version. Also used for the remaining components of the SIMD versions
+inline void mutationScalar (const MutationArgs& a, int begin = 0)
+{
+    for(int j = begin; j < a.N; ++j)
+        a.child[j] = a.u[j] < a.Cr ? mutated(a, j) : a.parent[j];
+}
+
+
+
+#ifdef MDE_SIMD_X86
+
+__attribute__((target("avx2")))
+inline void mutationAVX2 (const MutationArgs& a)
+{
+    const __m256d Cr = _mm256_set1_pd(a.Cr);
+    const __m256d Fa = _mm256_set1_pd(a.Fa);
+    const __m256d Fb = _mm256_set1_pd(a.Fb);
+
+    int j = 0;
+
+    for(; j + 4 <= a.N; j += 4)
+    {
+        __m256d parent = _mm256_loadu_pd(a.parent + j);
+
+        __m256d diffA = _mm256_sub_pd(_mm256_loadu_pd(a.best + j), _mm256_loadu_pd(a.x2 + j));
+        __m256d diffB = _mm256_sub_pd(parent, _mm256_loadu_pd(a.x1 + j));
+
+        __m256d value = _mm256_add_pd(_mm256_add_pd(_mm256_loadu_pd(a.x3 + j), _mm256_mul_pd(Fa, diffA)),
+                                      _mm256_mul_pd(Fb, diffB));
+
+        __m256d mask = _mm256_cmp_pd(_mm256_loadu_pd(a.u + j), Cr, _CMP_LT_OQ);
+
+        _mm256_storeu_pd(a.child + j, _mm256_blendv_pd(parent, value, mask));
+    }
+
+    mutationScalar(a, j);
+}
+
+
+__attribute__((target("avx512f")))
+inline void mutationAVX512 (const MutationArgs& a)
+{
+    const __m512d Cr = _mm512_set1_pd(a.Cr);
+    const __m512d Fa = _mm512_set1_pd(a.Fa);
+    const __m512d Fb = _mm512_set1_pd(a.Fb);
+
+    int j = 0;
+
+    for(; j + 8 <= a.N; j += 8)
+    {
+        __m512d parent = _mm512_loadu_pd(a.parent + j);
+
+        __m512d diffA = _mm512_sub_pd(_mm512_loadu_pd(a.best + j), _mm512_loadu_pd(a.x2 + j));
+        __m512d diffB = _mm512_sub_pd(parent, _mm512_loadu_pd(a.x1 + j));
+
+        __m512d value = _mm512_add_pd(_mm512_add_pd(_mm512_loadu_pd(a.x3 + j), _mm512_mul_pd(Fa, diffA)),
+                                      _mm512_mul_pd(Fb, diffB));
+
+        __mmask8 mask = _mm512_cmp_pd_mask(_mm512_loadu_pd(a.u + j), Cr, _CMP_LT_OQ);
+
+        _mm512_storeu_pd(a.child + j, _mm512_mask_blend_pd(mask, parent, value));
+    }
+
+    mutationScalar(a, j);
+}
+
+#endif
+
+
+
+/** Modified differential mutation, using the best kernel for the given 'level'. The component
+  * 'jRand' always gets the mutated value, whatever the value of 'u[jRand]'.
+*/
+inline void differentialMutation (const MutationArgs& a, int jRand, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: mutationAVX512(a); break;
+        case SimdLevel::AVX2:   mutationAVX2(a);   break;
+#endif
+        default:                mutationScalar(a); break;
+    }
+
+    a.child[jRand] = mutated(a, jRand);
+}
+
+
+
+/** Parameters of the bounds handling kernels. All of them work on a whole row, without branches
+  * in the loop. 'parent' is assumed to be inside the box [lower, upper].
+*/
+struct BoundsArgs
+{
+    double* child;
+    const double* parent;
+    const double* lower;
+    const double* upper;
+
+    int N;
+};
+
+
+/// Scalar versions. Also used for the remaining components of the SIMD versions
+
+/// child[j] = min(upper[j], max(lower[j], child[j]))
+inline void clipScalar (const BoundsArgs& a, int begin = 0)
+{
+    for(int j = begin; j < a.N; ++j)
+        a.child[j] = std::min(a.upper[j], std::max(a.lower[j], a.child[j]));
+}
+
+/// child[j] = parent[j] if child[j] is outside [lower[j], upper[j]]
+inline void conservateScalar (const BoundsArgs& a, int begin = 0)
+{
+    for(int j = begin; j < a.N; ++j)
+        a.child[j] = (a.child[j] >= a.lower[j] && a.child[j] <= a.upper[j]) ? a.child[j] : a.parent[j];
+}
+
+/// Mirrors the components outside the box at the violated bound, then clips (in case it is still outside)
+inline void reflectScalar (const BoundsArgs& a, int begin = 0)
+{
+    for(int j = begin; j < a.N; ++j)
+    {
+        double x = a.child[j];
+
+        x = x < a.lower[j] ? 2.0 * a.lower[j] - x : x;
+        x = x > a.upper[j] ? 2.0 * a.upper[j] - x : x;
+
+        a.child[j] = std::min(a.upper[j], std::max(a.lower[j], x));
+    }
+}
+
+/// Sets the components outside the box to the midpoint between the violated bound and the parent
+inline void midpointScalar (const BoundsArgs& a, int begin = 0)
+{
+    for(int j = begin; j < a.N; ++j)
+    {
+        double x = a.child[j];
+
+        x = x < a.lower[j] ? 0.5 * (a.lower[j] + a.parent[j]) : x;
+        x = x > a.upper[j] ? 0.5 * (a.upper[j] + a.parent[j]) : x;
+
+        a.child[j] = x;
+    }
+}
+
+/// Returns true if any component of the child is outside the box
+inline bool outsideScalar (const BoundsArgs& a, int begin = 0)
+{
+    bool outside = false;
+
+    for(int j = begin; j < a.N; ++j)
+        outside |= !(a.child[j] >= a.lower[j] && a.child[j] <= a.upper[j]);
+
+    return outside;
+}
+
+
+
+#ifdef MDE_SIMD_X86
+
+__attribute__((target("avx2")))
+inline void clipAVX2 (const BoundsArgs& a)
+{
+    int j = 0;
+
+    for(; j + 4 <= a.N; j += 4)
+        _mm256_storeu_pd(a.child + j, _mm256_min_pd(_mm256_loadu_pd(a.upper + j),
+                                      _mm256_max_pd(_mm256_loadu_pd(a.lower + j), _mm256_loadu_pd(a.child + j))));
+
+    clipScalar(a, j);
+}
+
+__attribute__((target("avx2")))
+inline void conservateAVX2 (const BoundsArgs& a)
+{
+    int j = 0;
+
+    for(; j + 4 <= a.N; j += 4)
+    {
+        __m256d x = _mm256_loadu_pd(a.child + j);
+
+        __m256d inside = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_loadu_pd(a.lower + j), _CMP_GE_OQ),
+                                       _mm256_cmp_pd(x, _mm256_loadu_pd(a.upper + j), _CMP_LE_OQ));
+
+        _mm256_storeu_pd(a.child + j, _mm256_blendv_pd(_mm256_loadu_pd(a.parent + j), x, inside));
+    }
+
+    conservateScalar(a, j);
+}
+
+__attribute__((target("avx2")))
+inline void reflectAVX2 (const BoundsArgs& a)
+{
+    const __m256d two = _mm256_set1_pd(2.0);
+
+    int j = 0;
+
+    for(; j + 4 <= a.N; j += 4)
+    {
+        __m256d x = _mm256_loadu_pd(a.child + j);
+        __m256d lower = _mm256_loadu_pd(a.lower + j);
+        __m256d upper = _mm256_loadu_pd(a.upper + j);
+
+        x = _mm256_blendv_pd(x, _mm256_sub_pd(_mm256_mul_pd(two, lower), x), _mm256_cmp_pd(x, lower, _CMP_LT_OQ));
+        x = _mm256_blendv_pd(x, _mm256_sub_pd(_mm256_mul_pd(two, upper), x), _mm256_cmp_pd(x, upper, _CMP_GT_OQ));
+
+        _mm256_storeu_pd(a.child + j, _mm256_min_pd(upper, _mm256_max_pd(lower, x)));
+    }
+
+    reflectScalar(a, j);
+}
+
+__attribute__((target("avx2")))
+inline void midpointAVX2 (const BoundsArgs& a)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    int j = 0;
+
+    for(; j + 4 <= a.N; j += 4)
+    {
+        __m256d x = _mm256_loadu_pd(a.child + j);
+        __m256d lower = _mm256_loadu_pd(a.lower + j);
+        __m256d upper = _mm256_loadu_pd(a.upper + j);
+        __m256d parent = _mm256_loadu_pd(a.parent + j);
+
+        x = _mm256_blendv_pd(x, _mm256_mul_pd(half, _mm256_add_pd(lower, parent)), _mm256_cmp_pd(x, lower, _CMP_LT_OQ));
+        x = _mm256_blendv_pd(x, _mm256_mul_pd(half, _mm256_add_pd(upper, parent)), _mm256_cmp_pd(x, upper, _CMP_GT_OQ));
+
+        _mm256_storeu_pd(a.child + j, x);
+    }
+
+    midpointScalar(a, j);
+}
+
+__attribute__((target("avx2")))
+inline bool outsideAVX2 (const BoundsArgs& a)
+{
+    __m256d inside = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    int j = 0;
+
+    for(; j + 4 <= a.N; j += 4)
+    {
+        __m256d x = _mm256_loadu_pd(a.child + j);
+
+        inside = _mm256_and_pd(inside, _mm256_and_pd(_mm256_cmp_pd(x, _mm256_loadu_pd(a.lower + j), _CMP_GE_OQ),
+                                                     _mm256_cmp_pd(x, _mm256_loadu_pd(a.upper + j), _CMP_LE_OQ)));
+    }
+
+    return _mm256_movemask_pd(inside) != 0xF || outsideScalar(a, j);
+}
+
+
+
+/// Same as '_mm512_min_pd' and '_mm512_max_pd'. Some versions of GCC give a false "uninitialized" warning for them
+__attribute__((target("avx512f")))
+inline __m512d min512 (__m512d a, __m512d b) { return _mm512_maskz_min_pd(0xFF, a, b); }
+
+__attribute__((target("avx512f")))
+inline __m512d max512 (__m512d a, __m512d b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+
+
+__attribute__((target("avx512f")))
+inline void clipAVX512 (const BoundsArgs& a)
+{
+    int j = 0;
+
+    for(; j + 8 <= a.N; j += 8)
+        _mm512_storeu_pd(a.child + j, min512(_mm512_loadu_pd(a.upper + j),
+                                      max512(_mm512_loadu_pd(a.lower + j), _mm512_loadu_pd(a.child + j))));
+
+    clipScalar(a, j);
+}
+
+__attribute__((target("avx512f")))
+inline void conservateAVX512 (const BoundsArgs& a)
+{
+    int j = 0;
+
+    for(; j + 8 <= a.N; j += 8)
+    {
+        __m512d x = _mm512_loadu_pd(a.child + j);
+
+        __mmask8 inside = _mm512_cmp_pd_mask(x, _mm512_loadu_pd(a.lower + j), _CMP_GE_OQ) &
+                          _mm512_cmp_pd_mask(x, _mm512_loadu_pd(a.upper + j), _CMP_LE_OQ);
+
+        _mm512_storeu_pd(a.child + j, _mm512_mask_blend_pd(inside, _mm512_loadu_pd(a.parent + j), x));
+    }
+
+    conservateScalar(a, j);
+}
+
+__attribute__((target("avx512f")))
+inline void reflectAVX512 (const BoundsArgs& a)
+{
+    const __m512d two = _mm512_set1_pd(2.0);
+
+    int j = 0;
+
+    for(; j + 8 <= a.N; j += 8)
+    {
+        __m512d x = _mm512_loadu_pd(a.child + j);
+        __m512d lower = _mm512_loadu_pd(a.lower + j);
+        __m512d upper = _mm512_loadu_pd(a.upper + j);
+
+        x = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, lower, _CMP_LT_OQ), x, _mm512_sub_pd(_mm512_mul_pd(two, lower), x));
+        x = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, upper, _CMP_GT_OQ), x, _mm512_sub_pd(_mm512_mul_pd(two, upper), x));
+
+        _mm512_storeu_pd(a.child + j, min512(upper, max512(lower, x)));
+    }
+
+    reflectScalar(a, j);
+}
+
+__attribute__((target("avx512f")))
+inline void midpointAVX512 (const BoundsArgs& a)
+{
+    const __m512d half = _mm512_set1_pd(0.5);
+
+    int j = 0;
+
+    for(; j + 8 <= a.N; j += 8)
+    {
+        __m512d x = _mm512_loadu_pd(a.child + j);
+        __m512d lower = _mm512_loadu_pd(a.lower + j);
+        __m512d upper = _mm512_loadu_pd(a.upper + j);
+        __m512d parent = _mm512_loadu_pd(a.parent + j);
+
+        x = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, lower, _CMP_LT_OQ), x, _mm512_mul_pd(half, _mm512_add_pd(lower, parent)));
+        x = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, upper, _CMP_GT_OQ), x, _mm512_mul_pd(half, _mm512_add_pd(upper, parent)));
+
+        _mm512_storeu_pd(a.child + j, x);
+    }
+
+    midpointScalar(a, j);
+}
+
+__attribute__((target("avx512f")))
+inline bool outsideAVX512 (const BoundsArgs& a)
+{
+    __mmask8 inside = 0xFF;
+
+    int j = 0;
+
+    for(; j + 8 <= a.N; j += 8)
+    {
+        __m512d x = _mm512_loadu_pd(a.child + j);
+
+        inside &= _mm512_cmp_pd_mask(x, _mm512_loadu_pd(a.lower + j), _CMP_GE_OQ) &
+                  _mm512_cmp_pd_mask(x, _mm512_loadu_pd(a.upper + j), _CMP_LE_OQ);
+    }
+
+    return inside != 0xFF || outsideScalar(a, j);
+}
+
+#endif
+
+
+
+/// The bounds handling kernels, using the best version for the given 'level'
+
+inline void clipBounds (const BoundsArgs& a, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: clipAVX512(a); break;
+        case SimdLevel::AVX2:   clipAVX2(a);   break;
+#endif
+        default:                clipScalar(a); break;
+    }
+}
+
+inline void conservateBounds (const BoundsArgs& a, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: conservateAVX512(a); break;
+        case SimdLevel::AVX2:   conservateAVX2(a);   break;
+#endif
+        default:                conservateScalar(a); break;
+    }
+}
+
+inline void reflectBounds (const BoundsArgs& a, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: reflectAVX512(a); break;
+        case SimdLevel::AVX2:   reflectAVX2(a);   break;
+#endif
+        default:                reflectScalar(a); break;
+    }
+}
+
+inline void midpointBounds (const BoundsArgs& a, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: midpointAVX512(a); break;
+        case SimdLevel::AVX2:   midpointAVX2(a);   break;
+#endif
+        default:                midpointScalar(a); break;
+    }
+}
+
+inline bool outsideBounds (const BoundsArgs& a, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: return outsideAVX512(a);
+        case SimdLevel::AVX2:   return outsideAVX2(a);
+#endif
+        default:                return outsideScalar(a);
+    }
+}
+
+
+
+
+/** Writes to 'changed' the indices 'j' where 'child[j] != parent[j]', in increasing order, and returns
+  * how many there are. 'changed' must have room for 'N' indices. The index is always written, and
+  * the count only advances if the component changed, so there are no branches.
+*/
+inline int changedIndices (const double* child, const double* parent, int N, int* changed)
+{
+    int count = 0;
+
+    for(int j = 0; j < N; ++j)
+    {
+        changed[count] = j;
+        count += child[j] != parent[j];
+    }
+
+    return count;
+}
+
+
+
+
+/** Penalties of the constraints values, summed. For the 'n' inequalities 'g', the sum of max(0, g[i]).
+  * For the 'n' equalities 'h', the sum of |h[i]|, ignoring the ones with |h[i]| < 'eqTol'. The SIMD
+  * versions keep one partial sum per lane, so the result may differ in the last bits from the scalar one.
+  * A NaN inequality counts as 0 in every version, as in 'std::max(0.0, g[i])': the SIMD 'max' returns
+  * its second operand if any of them is NaN, so the values are its first operand. A NaN equality is
+  * summed, giving a NaN penalty.
+*/
+inline double inequalityPenaltyScalar (const double* g, int n, int begin = 0)
+{
+    double sum = 0.0;
+
+    for(int i = begin; i < n; ++i)
+        sum += std::max(0.0, g[i]);
+
+    return sum;
+}
+
+inline double equalityPenaltyScalar (const double* h, int n, double eqTol, int begin = 0)
+{
+    double sum = 0.0;
+
+    for(int i = begin; i < n; ++i)
+        sum += std::abs(h[i]) < eqTol ? 0.0 : std::abs(h[i]);
+
+    return sum;
+}
+
+
+
+#ifdef MDE_SIMD_X86
+
+__attribute__((target("avx2")))
+inline double horizontalSum (__m256d v)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+__attribute__((target("avx2")))
+inline double inequalityPenaltyAVX2 (const double* g, int n)
+{
+    __m256d sum = _mm256_setzero_pd();
+
+    int i = 0;
+
+    for(; i + 4 <= n; i += 4)
+        sum = _mm256_add_pd(sum, _mm256_max_pd(_mm256_loadu_pd(g + i), _mm256_setzero_pd()));
+
+    return horizontalSum(sum) + inequalityPenaltyScalar(g, n, i);
+}
+
+__attribute__((target("avx2")))
+inline double equalityPenaltyAVX2 (const double* h, int n, double eqTol)
+{
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d tol = _mm256_set1_pd(eqTol);
+
+    __m256d sum = _mm256_setzero_pd();
+
+    int i = 0;
+
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d v = _mm256_andnot_pd(sign, _mm256_loadu_pd(h + i));
+
+        sum = _mm256_add_pd(sum, _mm256_andnot_pd(_mm256_cmp_pd(v, tol, _CMP_LT_OQ), v));
+    }
+
+    return horizontalSum(sum) + equalityPenaltyScalar(h, n, eqTol, i);
+}
+
+
+/// Same as '_mm512_reduce_add_pd', without the false "uninitialized" warning of some versions of GCC
+__attribute__((target("avx512f")))
+inline double horizontalSum (__m512d v)
+{
+    return horizontalSum(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, v, 0), _mm512_maskz_extractf64x4_pd(0xF, v, 1)));
+}
+
+__attribute__((target("avx512f")))
+inline double inequalityPenaltyAVX512 (const double* g, int n)
+{
+    __m512d sum = _mm512_setzero_pd();
+
+    int i = 0;
+
+    for(; i + 8 <= n; i += 8)
+        sum = _mm512_add_pd(sum, max512(_mm512_loadu_pd(g + i), _mm512_setzero_pd()));
+
+    return horizontalSum(sum) + inequalityPenaltyScalar(g, n, i);
+}
+
+__attribute__((target("avx512f")))
+inline double equalityPenaltyAVX512 (const double* h, int n, double eqTol)
+{
+    const __m512d tol = _mm512_set1_pd(eqTol);
+
+    __m512d sum = _mm512_setzero_pd();
+
+    int i = 0;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        __m512d v = _mm512_abs_pd(_mm512_loadu_pd(h + i));
+
+        sum = _mm512_mask_add_pd(sum, _mm512_cmp_pd_mask(v, tol, _CMP_NLT_UQ), sum, v);
+    }
+
+    return horizontalSum(sum) + equalityPenaltyScalar(h, n, eqTol, i);
+}
+
+#endif
+
+
+
+/// The penalty kernels, using the best version for the given 'level'
+
+inline double inequalityPenalty (const double* g, int n, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: return inequalityPenaltyAVX512(g, n);
+        case SimdLevel::AVX2:   return inequalityPenaltyAVX2(g, n);
+#endif
+        default:                return inequalityPenaltyScalar(g, n);
+    }
+}
+
+inline double equalityPenalty (const double* h, int n, double eqTol, SimdLevel level = simdLevel())
+{
+    switch(level)
+    {
+#ifdef MDE_SIMD_X86
+        case SimdLevel::AVX512: return equalityPenaltyAVX512(h, n, eqTol);
+        case SimdLevel::AVX2:   return equalityPenaltyAVX2(h, n, eqTol);
+#endif
+        default:                return equalityPenaltyScalar(h, n, eqTol);
+    }
+}
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_KERNELS_H
@@ -20,15 +20,23 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <limits>
 #include <ctime>
 #include <chrono>
-#include <map>
 #include <assert.h>
-#include <functional>
 #include <iostream>
+#include <memory>
 
 #include "Random.h"
 #include "Function.h"
+#include "ThreadPool.h"
+#include "Population.h"
+#include "Ranking.h"
+#include "Kernels.h"
+#include "Bounds.h"
+#include "Cache.h"
+#include "Store.h"
+#include "Dataset.h"
 
 
 
@@ -72,11 +80,82 @@ namespace mde
          *
          *  https://elektron.elka.pw.edu.pl/~jarabas/ALHE/krakow1.pdf
          *
-         *  These are the available methods: "clip" (default), "conservate", "conservateall", 
-         *  "reinitialize". I comment very briefly how they work above their definition. 
-         *  Again, for more details, please, refer to the papers.
+         *  These are the available methods: "conservate" (default), "conservateall", "clip", 
+         *  "reinitialize", "reflection" and "midpoint". I comment very briefly how they work 
+         *  above their definition (see 'Bounds.h'). Again, for more details, please, refer to 
+         *  the papers. This option is only used if the bounds policy of the 'MDE' class is 
+         *  'bounds::Runtime' (the default).
         */
         std::string bndHandle;
+
+
+        /** Number of threads used to generate and evaluate the children. With 1 (the default)
+          * everything runs serially on the calling thread. With 0, all the available cores are
+          * used. If more than one thread is used, the children of every parent are created and 
+          * evaluated concurrently, and the selection is done at the end of the generation, in order.
+          * In this case, the 'operator()' of your function must be safe to call from many threads.
+        */
+        int threads = 1;
+
+
+        /** Constraint-first lazy evaluation. If true, the constraints of each child are evaluated first,
+          * and the objective is only evaluated if the child is feasible, or if the selection of its parent
+          * compares only the fitness values (see 'Sr'). An infeasible child loses to any feasible candidate
+          * and is compared to the infeasible ones by its violation only, so its fitness is not needed. If
+          * it is needed later (the child replaced its parent and the fitness only comparison is used), it 
+          * is evaluated at that moment. Only used if the function defines the objective and the constraints
+          * in separate functions (not the fused 'evaluate' or 'evaluateBatch'), and not used with 'evaluateAsync'.
+          * See 'MDE::skippedObjectives'.
+        */
+        bool lazy = false;
+
+
+        /** Asynchronous steady-state mode, only used if more than one thread is used. There are no generations: each
+          * thread takes the next parent, creates and evaluates its children and does the selection right away, so a
+          * slow evaluation doesn't keep the other threads waiting. The rows of the population and the 'best' element
+          * are guarded by their own locks, only held while they are copied. The total number of parents processed is
+          * the same of the generational mode ('maxIter' times 'popSize'). The result depends on the timing of the
+          * threads, so it is not reproducible. Not used if the function defines 'evaluateBatch' or 'evaluateAsync'.
+        */
+        bool asynchronous = false;
+
+
+        /** Maximum number of evaluations in flight at once, if the function defines 'evaluateAsync' (see 'mde::Function').
+          * With 0 (the default), every child of a generation may be in flight. The children are created as usual (in
+          * parallel, if there is a pool), and then launched in order from the calling thread, which waits for the oldest
+          * evaluation whenever the limit is reached. The selection is done at the end of the generation.
+        */
+        int maxInFlight = 0;
+
+
+        /** Memory budget, in bytes, of the cache of evaluations. With 0 (the default), there is no cache. Otherwise,
+          * a child with exactly the same coordinates of a candidate evaluated before takes its values from the cache,
+          * without calling the function. This is useful for expensive deterministic functions, as children repaired by
+          * the bounds handling (or created with a small 'Cr') often are copies of their parents or of each other. When
+          * the cache is full, the least recently used entry is replaced. See 'MDE::cacheHits' and 'help::EvaluationCache'.
+          * It is not used by the 'evaluateBatch' and 'evaluateAsync' functions.
+        */
+        std::size_t cacheMemory = 0;
+
+        /** If positive, the coordinates are rounded to multiples of this value before looking them up in the cache (and
+          * in the store), so a child close enough to a candidate evaluated before takes its values. The fitness is then
+          * approximated.
+        */
+        double cacheResolution = 0.0;
+
+
+        /** Path of the file of the persistent store of evaluations. With an empty path (the default), there is no store.
+          * Otherwise, the evaluations are also kept in this file, so other runs (even at the same time, in other processes)
+          * reuse them. The records are tagged by 'storeProblem', that must identify the function and its instance, so 
+          * many problems can share the same file, and by 'cacheResolution', so only the runs with the same resolution
+          * share their records. A child not found in the cache is looked up in the store before calling the function,
+          * and every new evaluation is added to both. See 'help::PersistentStore'.
+        */
+        std::string storePath;
+
+        std::string storeProblem;   /// Identity of the problem in the store. Required with a 'storePath'. See above
+
+        std::size_t storeMemory = std::size_t(1) << 30;   /// Maximum size of the file of the store, in bytes, when it is created
     };
 
 
@@ -94,142 +173,832 @@ namespace mde
       * mde::MDE<FunctionType> myMde(params);    // Create a 'mde::MDE' class with 'FunctionType' function passing 
                                                  // the 'params' as arguments. All the other arguments are default
       * auto best = myMde();     // Execute and retrieve the best element                           
+      *
+      * The bounds handling can also be fixed at compile time, so it is inlined in the mutation:
+      *
+      * mde::MDE<FunctionType, mde::bounds::Clip> myMde(params);   // 'params.bndHandle' is ignored
     */
 
-    template <class FunctionType>
+    template <class FunctionType, class BoundsPolicy = bounds::Runtime>
     class MDE : Parameters
     {
     public:
 
         using Function   = SetValues<FunctionType>;    /// The 'Function' type is inherited by 'SetValues'
         using Vector     = typename Function::Vector;  /// The 'Vector' type is defined by 'FunctionType'
-        using Population = std::vector<Vector>;        /// The 'Population' type is a 'std::vector' of 'Vector's
+        using Population = help::Population;           /// Contiguous matrix of candidates. See 'Population.h'
+
+
+        /** Everything a thread needs to generate children by itself: its own random
+          * generators, a buffer of random numbers and a 'Vector' used to call the function.
+          * The serial version uses 'workers[0]'. Nothing here is allocated after 'initialize'.
+        */
+        struct Worker
+        {
+            std::vector<double> uniform;   /// 'N' uniform numbers in [0, 1), drawn at once for each child
+
+            Vector child;       /// The child being evaluated
+
+            std::vector<int> changed;   /// Indices where the child differs from its parent. See 'evaluateDelta'
+
+            std::vector<double> key;      /// Key of the child in the cache and in the store, and its hash. See 'Parameters::cacheMemory'
+            std::uint64_t hash = 0;
+
+            std::vector<double> cached;   /// Values of an entry of the cache: fitness, violation and the constraints values
+
+            Population snapshot;   /// Copies of the rows used by the asynchronous mode. See 'asynchronousStep'
+            Population brood;      /// Children of the asynchronous mode
+
+            Workspace workspace;   /// Temporaries used to call the function. See 'SetValues'
 
+            long evaluations = 0;   /// Number of evaluations done by this worker
 
-        /// Type of the function pointer for the bounds handling functions. See the 'Parameters' class
-        using BoundsHandle = void (MDE::*)(Vector&, const Vector&);
+            long skipped = 0;   /// Number of objective evaluations skipped by this worker. See 'Parameters::lazy'
+
+            ::help::RandInt    randInt;      /// Generate a random integer given an interval
+            ::help::RandDouble randDouble;   /// Generate a random real given an interval
+        };
 
 
         /// Here you can pass a 'Parameters' class and an 'FunctionType' with the parameters you want
         MDE (const Parameters& param,
-             const FunctionType& function = FunctionType()) : Parameters(param), permutation(popSize), 
-                                                              population(popSize), function(eqTol, function)
+             const FunctionType& function = FunctionType()) : Parameters(param), function(eqTol, function)
         {
             initialize();  /// Call the initialization function
         }
 
 
         /// Here the parameters are all default, and you can pass an 'FunctionType' with the parameters you want
-        MDE (const FunctionType& function = FunctionType()) : permutation(popSize), population(popSize), 
-                                                              function(eqTol, function)
+        MDE (const FunctionType& function = FunctionType()) : function(eqTol, function)
         {
             initialize();  /// Call the initialization function
         }
 
 
 
-        /// Main function. Execute the MDE algorithm
+        /** Main function. Execute the MDE algorithm. After the first generation, the main loop does
+          * not allocate any memory: the children are created in preallocated slots and the best child
+          * of each parent is chosen by its index. The population is never sorted, because the algorithm
+          * only needs the best element, which is kept updated by the selection.
+        */
         Vector operator () ()
         {
-            /// Sort the population according to the comparison function defined in the 'mde::Vector' class
-            std::sort(population.begin(), population.end());
-
-            best = population.front();    /// The best element is always at the first position
+            /// Only the best element is needed, so there is no sorting, only a linear search
+            best = population.vector<Vector>(population.argmin());
 
             int iter = 0;    /// Iteration counter
 
 
+            /// Asynchronous version, without generations. See 'Parameters::asynchronous'
+            if(asynchronous && parallelParents() && !Function::hasBatch() && !Function::hasAsync())
+            {
+                if(!converged(best))
+                    asynchronousRun();
+
+                return result();
+            }
+
+
             /// Outter loop. Checks convergence and maximum iterations
             while(!converged(best) && iter++ < maxIter)
+                if(generation(iter))
+                    break;
+
+            /// Return best found solution (not the optimal one if 'function.optimal' is specified)
+            return result();
+        }
+
+
+        /** One generation of the main loop, where 'iter' is the number of the generation (from 1), used to update
+          * 'Sr'. Returns true if convergence is reached. The 'operator()' simply calls it until 'maxIter' generations
+          * are done. It can also be called directly, to run a few generations at a time (see 'Islands.h').
+        */
+        bool generation (int iter)
+        {
+            /// For each parent, decides if the selection compares only the fitness. See 'select'
+            for(int i = 0; i < popSize; ++i)
+                fitnessOnly[i] = randDouble(0.0, 1.0) < Sr;
+
+            /** Batch version. If the function defines 'evaluateBatch', all the children of the 
+              * generation are created first (in parallel, if possible) and then given to the 
+              * function at once. The selection is done in order at the end, as below. The same
+              * is done if the function defines 'evaluateAsync', launching the evaluations instead.
+            */
+            if(Function::hasBatch() || Function::hasAsync())
+            {
+                if(batchGeneration())
+                    return true;
+            }
+
+            /** Serial version. Iterates through all elements of the population, generating the
+              * children of each parent and selecting right away. So the next parents already
+              * see the updated population and 'best' element. If the function uses the pool
+              * itself, each of its evaluations may still be parallel. See 'parallelParents'.
+            */
+            else if(!parallelParents())
             {
-                /// First inner loop. Iterates through all elements of the population
-                for(int i = 0; i < population.size(); ++i)
+                for(int i = 0; i < popSize; ++i)
                 {
-                    Vector& parent = population[i];     /// The current parent
+                    breed(i, workers[0]);
 
-                    Vector bestChild(N);   /// The best child from all the generated children for the current parent
+                    if(select(i, bestSlot(i)))
+                        return true;
+                }
+            }
 
-                    /// Generate 'children' 
-                    for(int k = 0; k < children; ++k)
-                    {
-                        /** This is the easiest way (although not the fastest) to unbiasedly generate
-                          * three different random numbers that also differ from 'i'. These numbers are
-                          * the indexes for the three vectors needed for the modified differential mutation
-                        */ 
-                        std::random_shuffle(permutation.begin(), permutation.end());
+            /** Parallel version. First, the children of every parent are generated and evaluated
+              * concurrently, all of them using the population and 'best' element of the beggining
+              * of the generation. Then, the selection is done in order, on the calling thread.
+            */
+            else
+            {
+                pool->run(popSize, [this](int i, int w){ breed(i, workers[w]); });
+
+                for(int i = 0; i < popSize; ++i)
+                    if(select(i, bestSlot(i)))
+                        return true;
+            }
 
-                        const Vector& x1 = population[permutation[0] != i ? permutation[0] : permutation.back()];
-                        const Vector& x2 = population[permutation[1] != i ? permutation[1] : permutation.back()];
-                        const Vector& x3 = population[permutation[2] != i ? permutation[2] : permutation.back()];
+            /** The formula for calculating the 'Sr' probability. It drecreases smoothly in
+              * the first (maxIter / 3) iterations. Then, it is set permanently to 'Srmin'.
+            */
+            Sr = (iter < (maxIter / 3) ? Sr - (3.0 / maxIter) * (Srmax - Srmin) : Srmin);
 
-                        /// Perform the modified differential mutation and return a child
-                        Vector child = differentialMutation(x1, x2, x3, parent);
+            return false;
+        }
 
-                        /// Calling a member function with 'std::function' is easy like that
-                        boundsHandle(this, child, parent);
 
+        /** True if the parents are given to the pool to create and evaluate their children at once. Not if there is no
+          * pool, or if the function uses the pool in each evaluation (see 'mde::Function::usePool') and there are fewer
+          * parents than threads. Then, the candidates are evaluated one at a time, each one using every thread.
+        */
+        bool parallelParents () const
+        {
+            return pool && !(Function::hasPool() && popSize < pool->size());
+        }
 
-                        function(child);    /// Set fitness and violation for the new vector
 
-                        bestChild = std::min(bestChild, child);   /// Take the best between both
-                    }
+        /// The 'best' element. With lazy evaluation, its fitness may not be evaluated yet
+        const Vector& result ()
+        {
+            if(std::isnan(best.fitness))
+                completeFitness(best, workers[0]);
+
+            return best;
+        }
+
+
+
+        /** Generates and evaluates 'children' children for the parent 'i'. The children of the 
+          * parent 'i' are created in the rows [i * children, (i + 1) * children) of 'offspring'.
+        */
+        void breed (int i, Worker& worker)
+        {
+            breed(population, i, offspring, i * children, fitnessOnly[i], worker, [&](double* child){ makeChild(i, child, worker); });
+        }
+
+        /** General version of the function above. The parent is the row 'i' of 'parents', and each child is created
+          * by 'make' at a row of 'kids', from 'first' to 'first + children'. 'compareFitness' tells if the selection
+          * of this parent compares only the fitness values (see 'select').
+          *
+          * The objective receives a cutoff (if it takes one, see 'mde::Function'): the smallest fitness
+          * of a feasible parent or of a feasible child already evaluated. A child whose fitness is at
+          * least the cutoff can't win the selection in any case. If the cutoff came from a sibling, 
+          * 'bestSlot' keeps the first of them on ties. If it came from the parent, the child is not 
+          * better than the parent (and so not better than 'best') in both comparisons of 'select'.
+          * So the value returned by an early abort is never kept.
+        */
+        template <class MakeChild>
+        void breed (const Population& parents, int i, Population& kids, int first, bool compareFitness, Worker& worker, MakeChild make)
+        {
+            double cutoff = parents.violation[i] == 0.0 ? parents.fitness[i] : std::numeric_limits<double>::infinity();
+
+            /// Generate 'children' 
+            for(int k = first; k < first + children; ++k)
+            {
+                make(kids[k]);
+
+                /** Set fitness and violation for the new vector, unless they were evaluated before. They may be incremental,
+                  * using the values of the parent, and the fitness may be skipped if evaluation is lazy
+                */
+                if(!recall(kids, k, worker))
+                {
+                    if(Function::hasDelta() || Function::hasSparseConstraints())
+                        evaluateIncremental(parents, i, kids, k, compareFitness, worker, cutoff);
+
+                    else if(lazy && !compareFitness && Function::hasSeparateConstraints())
+                        evaluateLazy(kids, k, worker, cutoff);
+
+                    else
+                        evaluate(kids, k, worker, cutoff);
+
+                    remember(kids, k, worker, cutoff);
+                }
+
+                if(kids.violation[k] == 0.0)
+                    cutoff = std::min(cutoff, kids.fitness[k]);
+            }
+        }
+
+
+        /// Index of the best child of the parent 'i' in 'offspring' (using MDE comparison)
+        int bestSlot (int i) const
+        {
+            return bestSlot(offspring, i * children);
+        }
+
+        /// Same as above, for the children in the rows [first, first + children) of 'kids'
+        int bestSlot (const Population& kids, int first) const
+        {
+            int b = first;
+
+            for(int k = first + 1; k < first + children; ++k)
+                if(help::better(kids.fitness[k], kids.violation[k], kids.fitness[b], kids.violation[b]))
+                    b = k;
+
+            return b;
+        }
+
+
+        /** Asynchronous steady-state loop. Every worker of the pool takes the next step until 'maxIter * popSize' steps
+          * are done or convergence is reached. The step 't' processes the parent 't % popSize', and its probability of
+          * comparing only the fitness values is the 'Sr' of the generation 't / popSize'.
+        */
+        void asynchronousRun ()
+        {
+            const long steps = long(maxIter) * popSize;
+
+            std::atomic<long> next(0);
+            std::atomic<bool> stop(false);
 
-                    /// If convergence is reached, set 'best' to 'bestChild' and return it
-                    if(converged(bestChild))
-                        return (best = bestChild);
+            pool->run(pool->size(), [&](int, int w)
+            {
+                for(long t = next++; t < steps && !stop.load(std::memory_order_relaxed); t = next++)
+                {
+                    const long iter = t / popSize;
+                    const double sr = iter < maxIter / 3 ? Srmax - iter * (3.0 / maxIter) * (Srmax - Srmin) : Srmin;
+
+                    if(asynchronousStep(int(t % popSize), sr, workers[w]))
+                        stop = true;
+                }
+            });
+        }
+
+        /** One step of the asynchronous mode, for the parent 'i'. The parent, the three vectors of each mutation and
+          * the 'best' element are copied to the rows 0, 1 to 3 and 4 of 'worker.snapshot', each one while holding its
+          * lock. The children are created in 'worker.brood', so nothing else is written until 'commit'. 'cutoff' is the
+          * first cutoff of 'breed', taken from the parent in the snapshot. Returns true if convergence is reached.
+        */
+        bool asynchronousStep (int i, double sr, Worker& worker)
+        {
+            Population& snapshot = worker.snapshot;
+
+            const bool compareFitness = worker.randDouble(0.0, 1.0) < sr;
+
+            copyRow(i, snapshot, 0);
+
+            const double cutoff = snapshot.violation[0] == 0.0 ? snapshot.fitness[0] : std::numeric_limits<double>::infinity();
+
+            breed(snapshot, 0, worker.brood, 0, compareFitness, worker, [&](double* child)
+            {
+                int r[3];
+
+                worker.randInt.distinct(popSize, i, r, 3);
+
+                for(int m = 0; m < 3; ++m)
+                    copyRow(r[m], snapshot, m + 1);
+
+                {
+                    std::lock_guard<help::SpinLock> lock(bestLock);
+
+                    std::copy(best.begin(), best.end(), snapshot[4]);
+                }
+
+                mutate(snapshot[1], snapshot[2], snapshot[3], snapshot[0], snapshot[4], child, worker);
+            });
+
+            return commit(i, bestSlot(worker.brood, 0), compareFitness, cutoff, worker);
+        }
+
+        /// Copies the row 'i' of the population to the row 'j' of 'rows', holding the lock of the row 'i'
+        void copyRow (int i, Population& rows, int j)
+        {
+            std::lock_guard<help::SpinLock> lock(rowLocks[i]);
+
+            rows.assign(j, population, i);
+        }
+
+        /** Selection of the asynchronous mode, between the current parent 'i' (that may have changed since the step
+          * began) and the row 'b' of 'worker.brood'. The same as 'select', holding the locks of the row and of 'best'.
+          *
+          * A child whose fitness reached the 'cutoff' of the step may have been aborted early (see 'breed'), so its
+          * value is not exact. It lost to the parent of the snapshot, but the current parent may have been replaced
+          * by an infeasible row of lower fitness (by a step comparing only the fitness), which a feasible child would
+          * beat. So such a child is rejected: it never replaces any row, nor 'best'.
+          *
+          * A parent whose fitness was skipped by the lazy evaluation is evaluated without the lock of the row, so the
+          * other workers committing to it don't spin meanwhile. The row may be replaced during the evaluation, so the
+          * value is only kept if the row is the same, and the new row is checked again.
+        */
+        bool commit (int i, int b, bool compareFitness, double cutoff, Worker& worker)
+        {
+            const Population& kids = worker.brood;
+            const double fitness = kids.fitness[b];
+            const double violation = kids.violation[b];
+
+            if(Function::hasCutoff() && fitness >= cutoff)
+                return false;
+
+            if(converged(fitness, violation))
+            {
+                std::lock_guard<help::SpinLock> lock(bestLock);
+
+                setBest(kids[b], fitness, violation);
+                return true;
+            }
+
+            {
+                std::unique_lock<help::SpinLock> lock(rowLocks[i]);
+
+                while(compareFitness && std::isnan(population.fitness[i]))
+                {
+                    Vector& x = worker.child;
+
+                    std::copy(population[i], population[i] + N, x.begin());
+
+                    lock.unlock();
+
+                    const double value = completeFitness(x, worker);
 
+                    lock.lock();
 
-                    /** This is a feature of the 'MDE' method. With probability 'Sr' (that is 
-                      * calculated based on the values of 'Srmax' and 'Srmin') we compare the
-                      * vectors based only on their fitness values, instead of making the MDE
-                      * comparison. This is helpfull in situations where a solution is slightly
-                      * infeasible, but may be close to a optimum. In earlier stages of the
-                      * search, 'Sr' assumes greater values starting from 'Srmax', and then
-                      * decreases at every iteration, reaching 'Srmin'.
-                    */
-                    if(randDouble(0.0, 1.0) < Sr)
+                    if(std::isnan(population.fitness[i]) && std::equal(population[i], population[i] + N, x.begin()))
                     {
-                        if(bestChild.fitness < parent.fitness) /// Compare only the fitness value and take the best
-                            parent = bestChild;
+                        population.fitness[i] = value;
+                        break;
                     }
+                }
 
-                    else
-                        parent = std::min(parent, bestChild);  /// Use MDE comparison and thake the best
+                const bool replace = compareFitness ? fitness < population.fitness[i] :
+                                     help::better(fitness, violation, population.fitness[i], population.violation[i]);
+
+                if(replace)
+                    population.assign(i, kids, b);
+            }
+
+            std::lock_guard<help::SpinLock> lock(bestLock);
+
+            if(help::better(fitness, violation, best.fitness, best.violation))
+                setBest(kids[b], fitness, violation);
+
+            return false;
+        }
+
+
+
+        /// Creates a new child (not evaluated) for the parent 'i', writing its variables to 'child'
+        void makeChild (int i, double* child, Worker& worker)
+        {
+            const double* parent = population[i];     /// The current parent
+
+            /** Generate three different random numbers that also differ from 'i', in constant
+              * expected time. These numbers are the indexes for the three vectors needed for 
+              * the modified differential mutation
+            */ 
+            int r[3];
+
+            worker.randInt.distinct(popSize, i, r, 3);
+
+            const double* x1 = population[r[0]];
+            const double* x2 = population[r[1]];
+            const double* x3 = population[r[2]];
+
+            mutate(x1, x2, x3, parent, best.data(), child, worker);
+        }
+
+        /// Creates a new child from the given rows, writing its variables to 'child'
+        void mutate (const double* x1, const double* x2, const double* x3, const double* parent, const double* bestRow,
+                     double* child, Worker& worker)
+        {
+            /// Perform the modified differential mutation, writing the result to 'child'
+            differentialMutation(x1, x2, x3, parent, bestRow, child, worker);
+
+            /// Handle the bounds. The policy is known at compile time, so this call is inlined
+            boundsPolicy(child, parent, function.lowerBounds.data(), function.upperBounds.data(), N, worker.randDouble);
+        }
+
+
+        /** Creates all the children of the generation in a contiguous block, evaluates them with a 
+          * single call to the function (or asynchronously, see 'evaluateAsync') and then does the
+          * selection. Returns true if convergence is reached.
+        */
+        bool batchGeneration ()
+        {
+            /// The children of the parent 'i' are at the rows [i * children, (i + 1) * children)
+            auto produce = [this](int i, int w)
+            {
+                for(int k = 0; k < children; ++k)
+                    makeChild(i, offspring[i * children + k], workers[w]);
+            };
+
+            if(pool)
+                pool->run(popSize, produce);
+
+            else
+                for(int i = 0; i < popSize; ++i)
+                    produce(i, 0);
+
+
+            evaluate(offspring);    /// All children are evaluated at once
+
+
+            /// Take the best child of each parent and do the selection
+            for(int i = 0; i < popSize; ++i)
+                if(select(i, bestSlot(i)))
+                    return true;
+
+            return false;
+        }
+
+
+
+        /** Selection between the parent 'i' and its best child, at the row 'b' of 'offspring'. Also
+          * updates the 'best' element. Returns true if convergence is reached. The child is only
+          * copied (a single 'memcpy', no allocation) if it replaces the parent or the 'best' element.
+        */
+        bool select (int i, int b)
+        {
+            const double* bestChild = offspring[b];
+            const double fitness = offspring.fitness[b];
+            const double violation = offspring.violation[b];
+
+            /// If convergence is reached, set 'best' to 'bestChild' and return it
+            if(converged(fitness, violation))
+            {
+                setBest(bestChild, fitness, violation);
+                return true;
+            }
+
+
+            /** This is a feature of the 'MDE' method. With probability 'Sr' (that is 
+              * calculated based on the values of 'Srmax' and 'Srmin') we compare the
+              * vectors based only on their fitness values, instead of making the MDE
+              * comparison. This is helpfull in situations where a solution is slightly
+              * infeasible, but may be close to a optimum. In earlier stages of the
+              * search, 'Sr' assumes greater values starting from 'Srmax', and then
+              * decreases at every iteration, reaching 'Srmin'.
+            */
+            bool replace;
+
+            if(fitnessOnly[i])
+            {
+                if(std::isnan(population.fitness[i]))    /// Skipped by the lazy evaluation, so it is evaluated now
+                    completeFitness(i, workers[0]);
+
+                replace = fitness < population.fitness[i];   /// Compare only the fitness value and take the best
+            }
+
+            else   /// Use MDE comparison and thake the best
+                replace = help::better(fitness, violation, population.fitness[i], population.violation[i]);
+
+            if(replace)
+                population.assign(i, offspring, b);
+
+            /// Take the best between both (using MDE comparison)
+            if(help::better(fitness, violation, best.fitness, best.violation))
+                setBest(bestChild, fitness, violation);
+
+            return false;
+        }
+
+
+        /// Copies the given candidate to 'best'
+        void setBest (const double* x, double fitness, double violation)
+        {
+            std::copy(x, x + N, best.begin());
+
+            best.fitness = fitness;
+            best.violation = violation;
+        }
+
+
+
+        /** Sets the fitness and violation of every row of 'pop'. If the function defines 'evaluateBatch',
+          * it is called only once. If it defines 'evaluateAsync', many rows are in flight at once. Otherwise,
+          * the rows are evaluated one by one (in parallel, if possible).
+        */
+        void evaluate (Population& pop)
+        {
+            if(Function::hasBatch())
+            {
+                inequalities.resize(std::size_t(pop.size()) * function.numInequalities);
+                equalities.resize(std::size_t(pop.size()) * function.numEqualities);
+
+                Batch batch{ pop[0], pop.size(), N, pop.stride(), pop.fitness.data(), inequalities.data(), 
+                             equalities.data(), function.numInequalities, function.numEqualities };
 
-                    best = std::min(best, bestChild);   /// Take the best between both (using MDE comparison)
+                function(batch, pop.violation.data());
+
+                batchEvaluations += pop.size();
+            }
+
+            else if(Function::hasAsync())
+                evaluateAsync(pop);
+
+            else
+            {
+                auto single = [this, &pop](int i, int w){ evaluate(pop, i, workers[w]); };
+
+                if(pool)
+                    pool->run(pop.size(), single);
+
+                else
+                    for(int i = 0; i < pop.size(); ++i)
+                        single(i, 0);
+            }
+        }
+
+
+        /** Evaluates the rows of 'pop' with the 'evaluateAsync' of the function, keeping up to 'flights.size()' of them
+          * in flight. Each row is copied to its slot in 'flightVectors', where it stays until the evaluation completes,
+          * and its constraints are evaluated when it is launched. The rows complete in order: when every slot is taken,
+          * the oldest one is waited for. If an evaluation throws, the ones still in flight are waited for before the
+          * exception is rethrown, so no slot is in use afterwards.
+        */
+        void evaluateAsync (Population& pop)
+        {
+            Worker& worker = workers[0];
+
+            const int window = int(flights.size());
+
+            int launched = 0;   /// Rows launched
+            int done = 0;       /// Rows completed, or being completed
+
+            auto complete = [&](int i)
+            {
+                done = i + 1;
+
+                pop.fitness[i] = flights[i % window].get();
+            };
+
+            try
+            {
+                for(int i = 0; i < pop.size(); ++i)
+                {
+                    if(i >= window)    /// The slot is still taken by the row 'i - window'
+                        complete(i - window);
+
+                    Vector& x = flightVectors[i % window];
+
+                    std::copy(pop[i], pop[i] + N, x.begin());
+
+                    flights[i % window] = function.launch(x, worker.workspace);
+
+                    launched++;
+                    worker.evaluations++;
+
+                    pop.violation[i] = x.violation;
+
+                    if(Function::hasSparseConstraints())
+                        std::copy(worker.workspace.constraints.begin(), worker.workspace.constraints.end(), pop.constraintValues(i));
                 }
 
-                std::sort( population.begin(), population.end() );  /// Sort MDE population
+                while(done < launched)
+                    complete(done);
+            }
+            catch(...)
+            {
+                for(int i = done; i < launched; ++i)
+                {
+                    try { flights[i % window].get(); }
+                    catch(...) {}
+                }
 
-                /** The formula for calculating the 'Sr' probability. It drecreases smoothly in
-                  * the first (maxIter / 3) iterations. Then, it is set permanently to 'Srmin'.
-                */
-                Sr = (iter < (maxIter / 3) ? Sr - (3.0 / maxIter) * (Srmax - Srmin) : Srmin);
+                throw;
             }
+        }
 
-            /// Return best found solution (not the optimal one if 'function.optimal' is specified)
-            return best;
+
+        /** Lazy version of the function below. Only the violation is evaluated first. The fitness is only evaluated 
+          * if the candidate is feasible. Otherwise, it is set to NaN, meaning that it was not evaluated.
+        */
+        void evaluateLazy (Population& pop, int i, Worker& worker, double cutoff)
+        {
+            Vector& x = worker.child;
+
+            std::copy(pop[i], pop[i] + N, x.begin());
+
+            function.setViolation(x, worker.workspace);
+
+            if(x.violation == 0.0)
+                function.setFitness(x, worker.workspace, cutoff);
+
+            else
+            {
+                x.fitness = std::numeric_limits<double>::quiet_NaN();
+                worker.skipped++;
+            }
+
+            worker.evaluations++;
+
+            pop.fitness[i] = x.fitness;
+            pop.violation[i] = x.violation;
         }
 
 
-        /// Initialization procedure. Must be called if you want to run the algorithm again from scratch
-        void initialize ()
+        /// Evaluates the fitness of the parent 'i', skipped before by the lazy evaluation, using the temporaries of 'worker'
+        void completeFitness (int i, Worker& worker)
         {
-            /// A mapping from a string to a pointer to member function for handling the bounds
-            static std::map<std::string, BoundsHandle> bndMap = {{ "conservate",    &MDE::conservate   },
-                                                                 { "clip",          &MDE::clip         },
-                                                                 { "reinitialize",  &MDE::reinitialize }};
+            Vector& x = worker.child;
+
+            std::copy(population[i], population[i] + N, x.begin());
+
+            population.fitness[i] = completeFitness(x, worker);
+        }
 
-            /// Make the all the input lower case                                        
-            std::transform(bndHandle.begin(), bndHandle.end(), bndHandle.begin(), ::tolower);
+        /// Same as above, for a 'Vector'
+        double completeFitness (Vector& x, Worker& worker)
+        {
+            completed++;
 
+            return function.setFitness(x, worker.workspace);
+        }
 
-            /// Verify if the option exists and map to it
-            auto it = bndMap.find(bndHandle);
 
-            assert(it != bndMap.end() && "Invalid Bound handling option");
+        /** If the row 'k' of 'pop' is in the cache or in the persistent store, sets its values from there and returns
+          * true. A value found only in the store is also added to the cache. Otherwise, keeps the key of the row in
+          * 'worker', for 'remember'. Always false if there is neither cache nor store.
+        */
+        bool recall (Population& pop, int k, Worker& worker)
+        {
+            if(!cache && !store)
+                return false;
+
+            worker.hash = help::candidateKey(pop[k], worker.key.data(), N, cacheResolution);
+
+            if(!(cache && cache->find(worker.key.data(), worker.hash, worker.cached.data())))
+            {
+                if(!(store && store->find(worker.key.data(), worker.hash, worker.cached.data())))
+                    return false;
+
+                if(cache)
+                    cache->insert(worker.key.data(), worker.hash, worker.cached.data());
+            }
+
+            pop.fitness[k] = worker.cached[0];
+            pop.violation[k] = worker.cached[1];
+
+            std::copy(worker.cached.begin() + 2, worker.cached.end(), pop.constraintValues(k));
+
+            return true;
+        }
+
+        /** Adds the row 'k' of 'pop', just evaluated, to the cache and to the persistent store. Its key must be in 'worker'
+          * (see 'recall'). Only exact values are kept: not the fitness skipped by the lazy evaluation, nor one at or above
+          * the 'cutoff', which may have been aborted early (see 'breed').
+        */
+        void remember (Population& pop, int k, Worker& worker, double cutoff = std::numeric_limits<double>::infinity())
+        {
+            if((!cache && !store) || std::isnan(pop.fitness[k]) || (Function::hasCutoff() && pop.fitness[k] >= cutoff))
+                return;
+
+            worker.cached[0] = pop.fitness[k];
+            worker.cached[1] = pop.violation[k];
+
+            std::copy(pop.constraintValues(k), pop.constraintValues(k) + pop.numConstraints(), worker.cached.begin() + 2);
+
+            if(cache)
+                cache->insert(worker.key.data(), worker.hash, worker.cached.data());
+
+            if(store)
+                store->insert(worker.key.data(), worker.hash, worker.cached.data());
+        }
+
+
+        /// Number of children taken from the cache since the last 'initialize'. See 'Parameters::cacheMemory'
+        long cacheHits () const
+        {
+            return cache ? cache->hits() : 0;
+        }
+
+        /// Number of children looked up in the cache but not found since the last 'initialize'
+        long cacheMisses () const
+        {
+            return cache ? cache->misses() : 0;
+        }
+
+        /// Number of children taken from the persistent store since the last 'initialize'. See 'Parameters::storePath'
+        long storeHits () const
+        {
+            return store ? store->hits() : 0;
+        }
+
+
+        /// Number of objective evaluations saved by the lazy evaluation since the last 'initialize'. See 'Parameters::lazy'
+        long skippedObjectives () const
+        {
+            long total = -completed;
+
+            for(const auto& worker : workers)
+                total += worker.skipped;
+
+            return total;
+        }
+
+
+
+        /** Sets the fitness and violation of the row 'i' of 'pop', calling the function with the 'Vector' of 'worker'.
+          * If the fitness is greater than or equal to 'cutoff', it may be inexact (see 'breed').
+        */
+        void evaluate (Population& pop, int i, Worker& worker, double cutoff = std::numeric_limits<double>::infinity())
+        {
+            Vector& x = worker.child;
+
+            std::copy(pop[i], pop[i] + N, x.begin());
+
+            function(x, worker.workspace, cutoff);
+
+            worker.evaluations++;
+
+            pop.fitness[i] = x.fitness;
+            pop.violation[i] = x.violation;
+
+            /// Keep the values of the constraints, for the incremental evaluation of the children
+            if(Function::hasSparseConstraints())
+                std::copy(worker.workspace.constraints.begin(), worker.workspace.constraints.end(), pop.constraintValues(i));
+        }
+
+
+
+        /** Incremental version of the function above, for the child at the row 'k' of 'kids' and its parent at the row 'i' of 'parents'.
+          * Only the indices where the child differs from the parent are given to the function, that may reuse the
+          * parent's fitness (see 'evaluateDelta') and constraints values (see 'constraintVariables'). The constraints
+          * are evaluated first, so the fitness is skipped for an infeasible child if evaluation is lazy. The fitness
+          * is evaluated completely if the parent has no fitness yet, or if every variable changed.
+        */
+        void evaluateIncremental (const Population& parents, int i, Population& kids, int k, bool compareFitness,
+                                  Worker& worker, double cutoff)
+        {
+            const int numChanged = help::changedIndices(kids[k], parents[i], N, worker.changed.data());
 
-            boundsHandle = it->second;
+            Vector& x = worker.child;
+
+            std::copy(kids[k], kids[k] + N, x.begin());
+
+            function.setViolation(x, worker.workspace, parents.constraintValues(i), kids.constraintValues(k),
+                                  worker.changed.data(), numChanged);
+
+            if(lazy && !compareFitness && x.violation != 0.0)
+            {
+                x.fitness = std::numeric_limits<double>::quiet_NaN();
+                worker.skipped++;
+            }
+
+            else if(std::isnan(parents.fitness[i]) || numChanged == N)
+                function.setFitness(x, worker.workspace, cutoff);
+
+            else
+                function.setFitness(x, worker.workspace, parents[i], parents.fitness[i], worker.changed.data(), numChanged);
+
+            worker.evaluations++;
+
+            kids.fitness[k] = x.fitness;
+            kids.violation[k] = x.violation;
+        }
+
+
+
+        /** Number of function evaluations since the last 'initialize', including the initial population.
+          * Each worker counts its own evaluations, so there is no contention, and they are summed here.
+        */
+        long evaluations () const
+        {
+            long total = batchEvaluations;
+
+            for(const auto& worker : workers)
+                total += worker.evaluations;
+
+            return total;
+        }
+
+
+
+        /** Indices of the population from the best to the worst (using MDE comparison), without moving
+          * the candidates. Large populations are radix sorted, or sorted in parallel if there is a pool.
+          * The returned reference is valid until the next call.
+        */
+        const std::vector<int>& rank ()
+        {
+            return ranking(population.fitness.data(), population.violation.data(), popSize, pool.get());
+        }
+
+
+
+        /// Initialization procedure. Must be called if you want to run the algorithm again from scratch
+        void initialize ()
+        {
+            /// Only the 'bounds::Runtime' policy uses the name of the bounds handling option
+            bounds::set(boundsPolicy, bndHandle);
 
 
 
@@ -248,6 +1017,8 @@ namespace mde
 
             assert(N && "Zero variables???");
 
+            assert(popSize >= 4 && "The mutation needs three candidates different from the parent");
+
             if(function.lowerBounds.empty())
                 function.lowerBounds = Vector(N, -1e8);
 
@@ -255,17 +1026,111 @@ namespace mde
                 function.upperBounds = Vector(N, 1e8);
 
 
-            /// Initializes the permutation vector used for selecting the three different vectors for the mutation
-            std::iota(permutation.begin(), permutation.end(), 0);
-    
+            /// One worker per thread. If more than one thread is used, the pool is created only once
+            if(threads != 1 && !pool)
+                pool = std::make_shared<help::ThreadPool>(threads);
+
+            workers.resize(pool ? pool->size() : 1);
+
+            function.setPool(pool.get());   /// Only used if the function defines 'usePool'
+
+
+            /// Values of the constraints kept for each candidate. Only needed for the incremental evaluation of the constraints
+            const int numConstraints = Function::hasSparseConstraints() ? function.numInequalities + function.numEqualities : 0;
+
+            if(Function::hasSparseConstraints())
+                function.setDependencies(N);
+
+
+            /// Temporaries of each worker
+            for(auto& worker : workers)
+            {
+                worker.uniform.resize(N);
+                worker.changed.resize(N);
+                worker.key.resize(N);
+                worker.cached.resize(2 + numConstraints);
 
+                worker.snapshot.resize(5, N, numConstraints);
+                worker.brood.resize(children, N, numConstraints);
+
+                worker.child = Vector(N);
+
+                worker.workspace.values.reserve(N);
+                worker.workspace.inequalities.reserve(function.numInequalities);
+                worker.workspace.equalities.reserve(function.numEqualities);
+                worker.workspace.constraints.reserve(numConstraints);
+                worker.workspace.marks.reserve(numConstraints);
+
+                worker.evaluations = 0;
+                worker.skipped = 0;
+            }
+
+
+            /// The slots for the children. There is one row for each child of the generation
+            offspring.resize(popSize * children, N, numConstraints);
+
+            best = Vector(N);
+
+            batchEvaluations = completed = 0;   /// The counters of the workers are reset above
+
+            fitnessOnly.resize(popSize);
+
+            rowLocks.resize(popSize);
+
+
+            /// The slots of the evaluations in flight. Only needed if the function defines 'evaluateAsync'
+            if(Function::hasAsync())
+            {
+                flightVectors.assign(maxInFlight > 0 ? maxInFlight : popSize * children, Vector(N));
+                flights.resize(flightVectors.size());
+            }
+    
 
             /// Initializes a random population
-            for(auto& x : population)
+            population.resize(popSize, N, numConstraints);
+
+            for(int i = 0; i < popSize; ++i)
+                newVector(population[i], randDouble);  /// 'N' dimensional candidate
+
+            evaluate(population);  /// Calculate both fitness and violation for every candidate
+
+            best = population.vector<Vector>(population.argmin());   /// So 'generation' can be called right away
+
+
+            /// The cache and the store start with the initial population
+            if(cacheMemory)
             {
-                x = newVector();  /// 'N' dimensional 'Vector' class
+                const std::size_t entries = cacheMemory / help::EvaluationCache::entryBytes(N, 2 + numConstraints);
 
-                function(x);  /// Calculate both fitness and violation for vector 'x'
+                if(!cache)
+                    cache = std::make_shared<help::EvaluationCache>();
+
+                cache->resize(entries, N, 2 + numConstraints, cacheResolution);
+            }
+
+            else
+                cache.reset();
+
+
+            if(!storePath.empty())
+            {
+                if(storeProblem.empty())
+                    throw std::runtime_error("The persistent store needs a 'storeProblem' identifying the problem");
+
+                store = std::make_shared<help::PersistentStore>();
+
+                store->open(storePath, storeProblem, N, 2 + numConstraints, storeMemory, cacheResolution);
+            }
+
+            else
+                store.reset();
+
+
+            for(int i = 0; i < popSize && (cache || store); ++i)
+            {
+                workers[0].hash = help::candidateKey(population[i], workers[0].key.data(), N, cacheResolution);
+
+                remember(population, i, workers[0]);
             }
         }
 
@@ -276,21 +1141,28 @@ namespace mde
         {
             Vector x(N);    /// Dummy constructor if it is a 'std::array'
 
+            newVector(x.data(), randDouble);
+
+            return x;
+        }
+
+        /// Same as above, writing the 'N' variables to 'x' and using the given random generator
+        void newVector (double* x, ::help::RandDouble& randDouble)
+        {
             /// Random value for each dimension
             for(int i = 0; i < N; ++i)
                 x[i] = randDouble(function.lowerBounds[i], function.upperBounds[i]);
-
-            return x;
         }
 
 
 
-        /// Modified differential mutation
-        Vector differentialMutation (const Vector& x1, const Vector& x2, const Vector& x3, const Vector& parent)
+        /// Modified differential mutation. The result is written to 'child'
+        void differentialMutation (const double* x1, const double* x2, const double* x3, const double* parent,
+                                   const double* bestRow, double* child, Worker& worker)
         {
-            Vector child(N);   /// The resulting child
+            int jRand = worker.randInt(0, N);   /// This component is guaranteed to not get a value from the parent
 
-            int jRand = randInt(0, N);   /// This component is guaranteed to not get a value from the parent
+            worker.randDouble.fill(worker.uniform.data(), N);   /// All the random numbers at once
 
 
             /** It works as follows. With probability 'Cr' or if 'j' == 'jRand', we set the component 'j' 
@@ -299,17 +1171,13 @@ namespace mde
               * the  difference between 'parent[j]' and 'x1'. 'Fa' is set to a large value (0.8) while 
               * 'Fb' assumes a small value (0.1). So, the contribution of the best found element is
               * greater than the contribution of the parent, increasing the selective pressure.
+              *
+              * The crossover mask and the weighted sum are computed for many components at once,
+              * using the widest SIMD instructions available. See 'Kernels.h'.
             */
-            for (int j = 0; j < N; ++j)
-            {
-                if (randDouble(0, 1.0) < Cr || j == jRand)
-                    child[j] = x3[j] + Fa * (best[j] - x2[j]) + Fb * (parent[j] - x1[j]);
+            help::MutationArgs args{ child, x1, x2, x3, bestRow, parent, worker.uniform.data(), Cr, Fa, Fb, N };
 
-                else
-                    child[j] = parent[j];
-            }
-
-            return child;
+            help::differentialMutation(args, jRand, simd);
         }
 
 
@@ -321,7 +1189,7 @@ namespace mde
         }
 
         /// Checks if a entire vector is whitin the bounds
-        bool withinBounds (const Vector& v)
+        bool withinBounds (const double* v)
         {
             for(int i = 0; i < N; ++i)
                 if(!withinBounds(v[i], i))
@@ -335,56 +1203,66 @@ namespace mde
         /// Vector x reached convergence if it is feasible and its fitness is smaller or equal to the optimal value
         inline bool converged (const Vector& x)
         {
-            return x.feasible() && (x.fitness <= function.optimal);
+            return converged(x.fitness, x.violation);
         }
 
+        /// Same as above, given only the fitness and violation values
+        inline bool converged (double fitness, double violation)
+        {
+            return violation == 0.0 && (fitness <= function.optimal);
+        }
 
 
-        /// These are the bounds handling functions.
 
-        /// If a dimension 'i' is outside the box, set the value of this dimension to the value of the parent
-        void conservate (Vector& child, const Vector& parent)
-        {
-            for(int i = 0; i < N; ++i)
-                if(!withinBounds(child[i], i))
-                    child[i] = parent[i];
-        }
+    //private:
 
-        /// Clip every dimension 'i' to stay in the range:   lower[i] <= x[i] <= upper[i]
-        void clip (Vector& child, const Vector&)
-        {
-            for(int i = 0; i < N; ++i)
-                child[i] = std::min(function.upperBounds[i], std::max(function.lowerBounds[i], child[i]));
-        }
 
-        /// If any component is outside the box, generate a new random vector
-        void reinitialize (Vector& child, const Vector&)
-        {
-            if(!withinBounds(child))
-                child = newVector();
-        }
+        BoundsPolicy boundsPolicy;   /// Bounds handling. See 'Bounds.h'
 
 
 
-    //private:
+        Population population;   /// Population matrix
+
+        Population offspring;   /// Slots for all the children of a generation
+
+        help::Ranking ranking;   /// Sorts the indices of the population. See 'rank'
+
+        std::vector<Worker> workers;   /// Random generators and temporaries of each thread
+
+        /// Storage for the constraints values, only used if the function defines 'evaluateBatch'
+        std::vector<double> inequalities;
+        std::vector<double> equalities;
+
+        long batchEvaluations = 0;   /// Number of evaluations done with 'evaluateBatch'
+
+        /// The type returned by 'evaluateAsync', or a 'std::future<double>'. See 'SetValues::launch'
+        using Flight = decltype(std::declval<Function&>().launch(std::declval<Vector&>(), std::declval<Workspace&>()));
+
+        std::vector<Vector> flightVectors;   /// Candidates being evaluated by 'evaluateAsync'
+        std::vector<Flight> flights;         /// Their futures
+
+        help::Counter completed;   /// Number of fitness values skipped by the lazy evaluation, but evaluated later
+
+        std::vector<char> fitnessOnly;   /// For each parent, if the selection compares only the fitness values
 
+        std::shared_ptr<help::ThreadPool> pool;   /// Only created if more than one thread is used
 
-        std::vector<int> permutation;   /// Permutation vector
+        std::vector<help::SpinLock> rowLocks;   /// Lock of each row of the population, for the asynchronous mode
 
-        /// 'std::function' pointing to the bounds handle function
-        std::function<void (MDE<FunctionType>*, Vector&, const Vector&)> boundsHandle;
+        help::SpinLock bestLock;   /// Lock of 'best', for the asynchronous mode
 
+        std::shared_ptr<help::EvaluationCache> cache;   /// Only created if 'cacheMemory' is not 0
 
+        std::shared_ptr<help::PersistentStore> store;   /// Only created if 'storePath' is not empty
 
-        Population population;   /// Population vector
+        help::SimdLevel simd = help::simdLevel();   /// Instruction set used by the kernels
 
         Vector best;    /// Best element at any time
 
         Function function;   /// Function
 
 
-        ::help::RandInt    randInt;      /// Generate a random integer given an interval
-        ::help::RandDouble randDouble;   /// Generate a random real given an interval
+        ::help::RandDouble randDouble;   /// Generate a random real given an interval, used in the selection
     };
 
 } // namespace de
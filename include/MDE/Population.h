@@ -0,0 +1,158 @@
+/** \file Population.h
+  *
+  * Storage for a population of candidates as a single contiguous matrix. The
+  * candidate 'i' is the row 'i', and every row starts at a cache line boundary
+  * (the rows are padded up to 'stride' elements). The fitness and violation
+  * values are stored apart, in two packed arrays. This way, the mutation loop
+  * only streams through contiguous memory, instead of following one pointer
+  * for each candidate. The 'Vector' class is only used at the interface, to
+  * copy a single candidate in and out of the matrix. Example:
+  *
+  * help::Population pop(30, 10);    // 30 candidates with 10 variables each
+  *
+  * double* x = pop[3];      // Variables of the candidate 3
+  * pop.fitness[3] = 1.0;    // Its fitness
+  *
+  * Optionally, the values of the constraints of each candidate are also kept, in
+  * another packed matrix with 'numConstraints' columns. See 'Function::constraint'.
+*/
+
+#ifndef MDE_POPULATION_H
+#define MDE_POPULATION_H
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "Aligned.h"
+#include "Vector.h"
+#include "Ranking.h"
+
+
+namespace mde
+{
+
+namespace help
+{
+
+class Population
+{
+public:
+
+    /// Aligned storage type
+    using Storage = std::vector<double, AlignedAllocator<double>>;
+
+
+    Population (int rows = 0, int N = 0, int numConstraints = 0)
+    {
+        resize(rows, N, numConstraints);
+    }
+
+
+    /// Changes the number of rows and columns, and of constraints values of each row. The contents are not preserved
+    void resize (int rows, int N, int numConstraints = 0)
+    {
+        numRows = rows;
+        numCols = N;
+        rowStride = int(paddedSize<double>(N));
+        numCons = numConstraints;
+
+        data.resize(std::size_t(rows) * rowStride);
+        fitness.resize(rows, 1e18);
+        violation.resize(rows, 1e18);
+        constraints.resize(std::size_t(rows) * numCons);
+    }
+
+
+
+    /// Pointer to the first variable of the candidate 'i'
+    double* operator [] (int i) { return data.data() + std::size_t(i) * rowStride; }
+
+    const double* operator [] (int i) const { return data.data() + std::size_t(i) * rowStride; }
+
+
+    int size () const { return numRows; }      /// Number of candidates
+    int cols () const { return numCols; }      /// Number of variables of each candidate
+    int stride () const { return rowStride; }  /// Distance between two consecutive candidates
+
+    int numConstraints () const { return numCons; }   /// Number of constraints values of each candidate
+
+
+    /// Pointer to the first constraint value of the candidate 'i'
+    double* constraintValues (int i) { return constraints.data() + std::size_t(i) * numCons; }
+
+    const double* constraintValues (int i) const { return constraints.data() + std::size_t(i) * numCons; }
+
+
+
+    /// Copies the candidate 'j' of 'pop' to the row 'i', including the constraints values
+    void assign (int i, const Population& pop, int j)
+    {
+        assign(i, pop[j], pop.fitness[j], pop.violation[j]);
+
+        std::copy(pop.constraintValues(j), pop.constraintValues(j) + numCons, constraintValues(i));
+    }
+
+    /// Copies the variables 'x', the 'fit' and 'viol' values to the row 'i'
+    void assign (int i, const double* x, double fit, double viol)
+    {
+        std::memcpy((*this)[i], x, numCols * sizeof(double));
+
+        fitness[i] = fit;
+        violation[i] = viol;
+    }
+
+    /// Copies a 'Vector' to the row 'i'
+    template <class Vector>
+    void assign (int i, const Vector& v)
+    {
+        assign(i, v.data(), v.fitness, v.violation);
+    }
+
+
+    /// Returns a copy of the candidate 'i' as a 'Vector'
+    template <class Vector>
+    Vector vector (int i) const
+    {
+        Vector v(numCols);
+
+        std::copy((*this)[i], (*this)[i] + numCols, v.begin());
+
+        v.fitness = fitness[i];
+        v.violation = violation[i];
+
+        return v;
+    }
+
+
+
+    /// Index of the best row. Nothing is sorted
+    int argmin () const
+    {
+        return Ranking::argmin(fitness.data(), violation.data(), numRows);
+    }
+
+
+
+    Storage data;       /// All the variables, row by row
+
+    Storage fitness;    /// Fitness of each candidate
+    Storage violation;  /// Violation of each candidate
+
+    Storage constraints;   /// Constraints values, 'numConstraints' for each candidate (optional)
+
+
+private:
+
+    int numRows = 0;
+    int numCols = 0;
+    int rowStride = 0;
+    int numCons = 0;
+};
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_POPULATION_H
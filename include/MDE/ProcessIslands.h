@@ -0,0 +1,603 @@
+/** \file ProcessIslands.h
+  *
+  * Island model between processes, for functions that can't be called from
+  * many threads (wrapping legacy code with global state, for example). Each
+  * process runs one island, and the islands exchange their individuals through
+  * a POSIX shared memory segment, created by the first process that opens it.
+  * The segment has a queue for each pair of islands (the same lock-free queues
+  * of 'Islands', see 'Islands.h'), the best individual found by any island and
+  * a stop signal, set when any island converges. No process ever waits for
+  * another. The last process to finish removes the segment. Example, where the
+  * same program is started 'numProcesses' times, with 'rank' from 0:
+  *
+  * mde::ProcessIsland<Function> island("/my-problem", rank, numProcesses, params, migration);
+  *
+  * auto best = island();    // Best individual of all the islands, once this one finishes
+  *
+  * Each process writes its rank and its process id to the segment. A process joins
+  * the run in the segment if any process of that run is still alive. Otherwise (the
+  * processes of a previous run crashed, and the segment was never removed), it starts
+  * a new run, clearing the stop signal, the best individual and the queues. So a
+  * process that opens the segment after every other one has finished runs alone,
+  * without migrants. The segment is local to a machine, so are the process ids.
+  *
+  * Only available on POSIX systems. Elsewhere, the constructor throws.
+*/
+
+#ifndef MDE_PROCESS_ISLANDS_H
+#define MDE_PROCESS_ISLANDS_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define MDE_SHARED_MEMORY_POSIX
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "Islands.h"
+
+
+namespace mde
+{
+
+namespace help
+{
+
+/** A queue of 'MigrationQueue' kept in memory given by the caller (a shared memory segment), so the producer and
+  * the consumer can be in different processes. Memory filled with zeros is an empty queue. Each slot has the
+  * fitness, the violation, the 'N' variables and the 'numConstraints' constraints values of an individual.
+*/
+class SharedQueue
+{
+public:
+
+    SharedQueue (char* memory, int capacity, int N, int numConstraints) : header(reinterpret_cast<Header*>(memory)),
+                                                                          slots(reinterpret_cast<double*>(header + 1)),
+                                                                          capacity(capacity), N(N), numConstraints(numConstraints) {}
+
+
+    /// Number of bytes used by a queue
+    static std::size_t bytes (int capacity, int N, int numConstraints)
+    {
+        return sizeof(Header) + std::size_t(capacity) * (2 + N + numConstraints) * sizeof(double);
+    }
+
+
+    /// Same as 'MigrationQueue::push'
+    bool push (const Population& pop, int i)
+    {
+        const std::uint64_t t = header->tail.load(std::memory_order_relaxed);
+
+        if(t - header->head.load(std::memory_order_acquire) == std::uint64_t(capacity))
+            return false;
+
+        double* slot = slotAt(t);
+
+        slot[0] = pop.fitness[i];
+        slot[1] = pop.violation[i];
+
+        std::copy(pop[i], pop[i] + N, slot + 2);
+        std::copy(pop.constraintValues(i), pop.constraintValues(i) + numConstraints, slot + 2 + N);
+
+        header->tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Same as 'MigrationQueue::pop'
+    bool pop (Population& pop, int i)
+    {
+        const std::uint64_t h = header->head.load(std::memory_order_relaxed);
+
+        if(h == header->tail.load(std::memory_order_acquire))
+            return false;
+
+        const double* slot = slotAt(h);
+
+        pop.assign(i, slot + 2, slot[0], slot[1]);
+
+        std::copy(slot + 2 + N, slot + 2 + N + numConstraints, pop.constraintValues(i));
+
+        header->head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+
+private:
+
+    struct Header
+    {
+        std::atomic<std::uint64_t> head;   /// Next individual to be taken
+        char padding[56];                  /// So 'head' and 'tail' are not in the same cache line
+        std::atomic<std::uint64_t> tail;   /// Next free slot
+        char padding2[56];
+    };
+
+    double* slotAt (std::uint64_t s) const { return slots + std::size_t(s % capacity) * (2 + N + numConstraints); }
+
+
+    Header* header;
+    double* slots;
+
+    int capacity;
+    int N;
+    int numConstraints;
+};
+
+
+
+/** The shared memory segment of 'ProcessIsland'. It has a header, the rank and process id of each process of the current
+  * run, the best individual found by any island and the queues between every pair of islands. Everything starts as
+  * zeros. The process that creates the segment, or that starts a new run in it, writes the sizes to the header, which
+  * the others check.
+*/
+class IslandSegment
+{
+public:
+
+    IslandSegment () = default;
+
+    IslandSegment (const IslandSegment&) = delete;
+    IslandSegment& operator = (const IslandSegment&) = delete;
+
+    ~IslandSegment ()
+    {
+        close();
+    }
+
+
+    /** Opens (or creates) the segment 'name' (starting with a '/') as the island 'rank' of 'numIslands' islands with
+      * 'N' variables and 'numConstraints' constraints values, and queues of 'capacity' individuals. Joins the current
+      * run if any of its processes is alive, and starts a new one otherwise (see the beginning of the file). Throws
+      * 'std::runtime_error' on failure, if the run was started with other sizes, or if the process starting it died
+      * before finishing (then, the segment must be removed by hand).
+    */
+    void open (const std::string& name, int rank, int numIslands, int N, int numConstraints, int capacity)
+    {
+#ifdef MDE_SHARED_MEMORY_POSIX
+        close();
+
+        this->name = name;
+        this->numIslands = numIslands;
+        this->N = N;
+        this->numConstraints = numConstraints;
+        this->capacity = capacity;
+
+        queueBytes = roundUp(SharedQueue::bytes(capacity, N, numConstraints));
+        slotsOffset = roundUp(sizeof(Header));
+        bestOffset = slotsOffset + roundUp(numIslands * sizeof(Slot));
+        queuesOffset = bestOffset + roundUp((N + 2) * sizeof(std::atomic<double>));
+        mappedBytes = queuesOffset + std::size_t(numIslands) * numIslands * queueBytes;
+
+        const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+
+        if(fd < 0)
+            throw std::runtime_error("Could not open the shared memory " + name);
+
+        struct stat info;
+
+        /// The segment only grows, so the processes can truncate it at once. The new bytes are zeros
+        if(::fstat(fd, &info) != 0 || (std::size_t(info.st_size) < mappedBytes && ::ftruncate(fd, off_t(mappedBytes)) != 0))
+        {
+            ::close(fd);
+            throw std::runtime_error("Could not resize the shared memory " + name);
+        }
+
+        void* address = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        ::close(fd);    /// The mapping stays valid
+
+        if(address == MAP_FAILED)
+            throw std::runtime_error("Could not map the shared memory " + name);
+
+        base = static_cast<char*>(address);
+
+
+        /** A new run is started (by writing the sizes and clearing everything else) if the segment is new or if every
+          * process of its run is dead. The others wait for it, and check that the sizes are the same.
+        */
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+        while(true)
+        {
+            std::uint32_t state = header()->state.load(std::memory_order_acquire);
+
+            if(state == 2 && alive())
+                break;
+
+            if(state != 1 && header()->state.compare_exchange_strong(state, 1, std::memory_order_acquire))
+            {
+                start(rank);
+                return;
+            }
+
+            if(std::chrono::steady_clock::now() > deadline)
+            {
+                close();
+                throw std::runtime_error("The shared memory " + name + " is being initialized by a process that died");
+            }
+
+            std::this_thread::yield();
+        }
+
+        if(header()->N != std::uint32_t(N) || header()->numConstraints != std::uint32_t(numConstraints) ||
+           header()->numIslands != std::uint32_t(numIslands) || header()->capacity != std::uint32_t(capacity))
+        {
+            close();
+            throw std::runtime_error("The shared memory " + name + " was created with other sizes");
+        }
+
+        join(rank);
+#else
+        (void)name; (void)rank; (void)numIslands; (void)N; (void)numConstraints; (void)capacity;
+
+        throw std::runtime_error("The island model between processes is only available on POSIX systems");
+#endif
+    }
+
+
+    /** Unmaps the segment. 'finish' tells if this process is done with it: the last one removes the segment, so
+      * a new run with the same name starts from scratch.
+    */
+    void close (bool finish = false)
+    {
+#ifdef MDE_SHARED_MEMORY_POSIX
+        if(!base)
+            return;
+
+        if(finish && --header()->running == 0)
+            ::shm_unlink(name.c_str());
+
+        ::munmap(base, mappedBytes);
+#endif
+        (void)finish;
+
+        base = nullptr;
+    }
+
+    bool isOpen () const { return base != nullptr; }
+
+
+
+    /// The queue from the island 'from' to the island 'to'
+    SharedQueue queue (int from, int to) const
+    {
+        return SharedQueue(base + queuesOffset + (std::size_t(from) * numIslands + to) * queueBytes, capacity, N, numConstraints);
+    }
+
+
+    /// Stop signal of every island
+    bool stopped () const { return header()->stop.load(std::memory_order_relaxed) != 0; }
+
+    void stop () { header()->stop.store(1, std::memory_order_relaxed); }
+
+
+
+    /** Replaces the best individual of all the islands by 'x', if it is better (using MDE comparison). If another process
+      * is writing it at the same time, nothing is done: the value is offered again at the next migration.
+    */
+    void offerBest (const double* x, double fitness, double violation)
+    {
+        std::uint32_t unlocked = 0;
+
+        if(!header()->bestLock.compare_exchange_strong(unlocked, 1, std::memory_order_acquire))
+            return;
+
+        std::atomic<double>* values = bestValues();
+
+        const std::uint64_t sequence = header()->bestSequence.load(std::memory_order_relaxed);
+
+        if(sequence == 0 || better(fitness, violation, values[0].load(std::memory_order_relaxed), values[1].load(std::memory_order_relaxed)))
+        {
+            header()->bestSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            values[0].store(fitness, std::memory_order_relaxed);
+            values[1].store(violation, std::memory_order_relaxed);
+
+            for(int j = 0; j < N; ++j)
+                values[2 + j].store(x[j], std::memory_order_relaxed);
+
+            header()->bestSequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        header()->bestLock.store(0, std::memory_order_release);
+    }
+
+
+    /** Copies the best individual of all the islands to 'x' and its values to 'fitness' and 'violation'. Returns false if
+      * no island offered one yet. The values are read again if a process was writing them at the same time.
+    */
+    bool best (double* x, double& fitness, double& violation) const
+    {
+        const std::atomic<double>* values = bestValues();
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+        while(true)
+        {
+            const std::uint64_t before = header()->bestSequence.load(std::memory_order_acquire);
+
+            if(before == 0)
+                return false;
+
+            if(before % 2)
+            {
+                if(std::chrono::steady_clock::now() > deadline)    /// The writer died while writing
+                    return false;
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            fitness = values[0].load(std::memory_order_relaxed);
+            violation = values[1].load(std::memory_order_relaxed);
+
+            for(int j = 0; j < N; ++j)
+                x[j] = values[2 + j].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(header()->bestSequence.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+    }
+
+
+
+private:
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "The islands need lock free atomics to be shared by processes");
+
+
+    struct Header
+    {
+        std::atomic<std::uint32_t> state;     /// 0 while empty, 1 while a run is being started, 2 after
+        std::uint32_t N;
+        std::uint32_t numConstraints;
+        std::uint32_t numIslands;
+        std::uint32_t capacity;
+
+        std::atomic<std::uint32_t> running;   /// Processes using the segment
+        std::atomic<std::uint32_t> stop;      /// Set when any island converges
+
+        std::atomic<std::uint32_t> bestLock;        /// Held by the process writing the best individual
+        std::atomic<std::uint64_t> bestSequence;    /// 0 if there is none yet. Odd while it is being written
+
+        std::atomic<std::uint64_t> epoch;     /// Number of the current run
+    };
+
+    /// The process running an island, and the run it joined
+    struct Slot
+    {
+        std::atomic<std::uint64_t> epoch;
+        std::atomic<std::int64_t> pid;
+    };
+
+
+#ifdef MDE_SHARED_MEMORY_POSIX
+
+    /// Starts a new run as the island 'rank'. Called while holding the state 1, so no other process uses the segment
+    void start (int rank)
+    {
+        header()->N = N;
+        header()->numConstraints = numConstraints;
+        header()->numIslands = numIslands;
+        header()->capacity = capacity;
+
+        header()->running = 0;
+        header()->stop = 0;
+        header()->bestLock = 0;
+        header()->bestSequence = 0;
+        header()->epoch++;
+
+        std::memset(base + slotsOffset, 0, mappedBytes - slotsOffset);    /// Slots, best individual and empty queues
+
+        join(rank);
+
+        header()->state.store(2, std::memory_order_release);
+    }
+
+    /// Writes this process to the slot of the island 'rank' of the current run
+    void join (int rank)
+    {
+        slots()[rank].pid = std::int64_t(::getpid());
+        slots()[rank].epoch = header()->epoch.load();
+
+        header()->running++;
+    }
+
+    /// Tells if any process of the current run is alive
+    bool alive () const
+    {
+        const std::uint64_t epoch = header()->epoch.load();
+
+        for(int r = 0; r < numIslands; ++r)
+        {
+            const std::int64_t pid = slots()[r].pid.load();
+
+            if(slots()[r].epoch.load() == epoch && pid > 0 && (::kill(pid_t(pid), 0) == 0 || errno == EPERM))
+                return true;
+        }
+
+        return false;
+    }
+
+#endif
+
+
+    static std::size_t roundUp (std::size_t bytes) { return (bytes + 63) / 64 * 64; }
+
+    Header* header () const { return reinterpret_cast<Header*>(base); }
+
+    Slot* slots () const { return reinterpret_cast<Slot*>(base + slotsOffset); }
+
+    /// Fitness, violation and the 'N' variables of the best individual
+    std::atomic<double>* bestValues () const { return reinterpret_cast<std::atomic<double>*>(base + bestOffset); }
+
+
+
+    std::string name;
+    char* base = nullptr;
+    std::size_t mappedBytes = 0;
+
+    int numIslands = 0;
+    int N = 0;
+    int numConstraints = 0;
+    int capacity = 0;
+
+    std::size_t queueBytes = 0;     /// Bytes of each queue, rounded to a cache line
+    std::size_t slotsOffset = 0;    /// Where the slots of the processes start
+    std::size_t bestOffset = 0;     /// Where the best individual starts
+    std::size_t queuesOffset = 0;   /// Where the queues start
+};
+
+} // namespace help
+
+
+
+
+/** One island of the model between processes. Each of the 'numProcesses' processes creates one, with its 'rank' (from
+  * 0) and the same 'name' of the segment. The 'Parameters' may be different in each process, but the 'migration' must
+  * be the same. See the beginning of the file.
+*/
+template <class FunctionType, class BoundsPolicy = bounds::Runtime>
+class ProcessIsland
+{
+public:
+
+    using Island     = MDE<FunctionType, BoundsPolicy>;
+    using Vector     = typename Island::Vector;
+    using Population = help::Population;
+
+
+    ProcessIsland (const std::string& name, int rank, int numProcesses, const Parameters& params = Parameters(),
+                   const Migration& migration = Migration(), const FunctionType& function = FunctionType()) :
+                   rank(rank), numProcesses(numProcesses), params(params), migration(migration), island(params, function)
+    {
+        assert(rank >= 0 && rank < numProcesses && "Invalid rank");
+
+        const int N = island.population.cols();
+        const int numConstraints = island.population.numConstraints();
+
+        segment.open(name, rank, numProcesses, N, numConstraints, std::max(1, migration.capacity > 0 ? migration.capacity : 4 * migration.elites));
+
+        arrival.resize(1, N, numConstraints);
+    }
+
+    ~ProcessIsland ()
+    {
+        segment.close(true);
+    }
+
+
+
+    /** Runs the island until it reaches 'maxIter' or any island converges. At every migration, the best individual of the
+      * island is also offered to the segment. Returns the best individual of all the islands that finished or offered
+      * one so far. If the island throws, the others are stopped and the exception is rethrown.
+    */
+    Vector operator () ()
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        stats = IslandStatistics();
+
+        auto queue = [this](int from, int to){ return segment.queue(from, to); };
+
+        try
+        {
+            bool done = island.converged(island.best);
+
+            for(int iter = 1; !done && iter <= params.maxIter && !segment.stopped(); ++iter)
+            {
+                done = island.generation(iter);
+
+                stats.generations++;
+
+                if(!done && iter % migration.interval == 0)
+                {
+                    if(numProcesses > 1)
+                    {
+                        help::emigrate(island, rank, numProcesses, migration, stats, queue);
+
+                        done = help::immigrate(island, rank, numProcesses, arrival, stats, queue);
+                    }
+
+                    segment.offerBest(island.best.data(), island.best.fitness, island.best.violation);
+                }
+            }
+
+            if(done)
+                segment.stop();
+        }
+
+        catch(...)
+        {
+            segment.stop();
+            throw;
+        }
+
+
+        Vector best = island.result();
+
+        segment.offerBest(best.data(), best.fitness, best.violation);
+
+        stats.evaluations = island.evaluations();
+        stats.fitness = best.fitness;
+        stats.violation = best.violation;
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        /// The offer above may have been skipped, if another process was writing at the same time
+        Vector global = best;
+
+        if(segment.best(global.data(), global.fitness, global.violation) &&
+           help::better(global.fitness, global.violation, best.fitness, best.violation))
+            return global;
+
+        return best;
+    }
+
+
+
+    /// Statistics of the island of this process during the last run
+    const IslandStatistics& statistics () const { return stats; }
+
+
+
+    int rank;            /// Index of this island
+    int numProcesses;    /// Number of islands
+
+    Parameters params;
+
+    Migration migration;
+
+    Island island;   /// The 'MDE' of this process
+
+
+private:
+
+    help::IslandSegment segment;
+
+    Population arrival;   /// Where the individuals from the other islands are received
+
+    IslandStatistics stats;
+};
+
+} // namespace mde
+
+
+#endif // MDE_PROCESS_ISLANDS_H
@@ -1,45 +1,181 @@
 /** \file Random.h
   *
-  * Simple helper classes to generate random uniform integer and 
+  * Simple helper classes to generate random uniform integer and
   * real numbers. Example:
-  * 
+  *
   * RandDouble randDouble;
-  * randDouble(0.0, 1.0);    // random number between 0.0 and 1.0   
+  * randDouble(0.0, 1.0);    // random number between 0.0 and 1.0
   *
-  * Notice that the RandInt is open in the right, so 'max' must be 
+  * Notice that the RandInt is open in the right, so 'max' must be
   * greater than 'min'.
   *
+  * The generator is a xoshiro256++, which is much faster and smaller than
+  * 'std::mt19937' and has very good statistical quality:
+  *
+  * http://prng.di.unimi.it/
+  *
+  * It satisfies the requirements of a uniform random bit generator, so it
+  * can also be used with the distributions and algorithms of the standard library.
 */
 
 #ifndef RANDOM_HELPER_H
 #define RANDOM_HELPER_H
 
 #include <random>
+#include <cstdint>
+#include <limits>
 
 namespace help
 {
+    /// xoshiro256++ generator, seeded using splitmix64
+    class Xoshiro256
+    {
+    public:
+
+        using result_type = std::uint64_t;
+
+        static constexpr result_type min () { return 0; }
+        static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+
+        explicit Xoshiro256 (std::uint64_t seed = 0x9E3779B97F4A7C15ull)
+        {
+            this->seed(seed);
+        }
+
+
+        /// Fills the state with splitmix64, so any seed (even 0) is fine
+        void seed (std::uint64_t seed)
+        {
+            for(auto& x : s)
+            {
+                std::uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+                x = z ^ (z >> 31);
+            }
+        }
+
+
+        inline result_type operator () ()
+        {
+            const std::uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+            const std::uint64_t t = s[1] << 17;
+
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+
+            return result;
+        }
+
+
+    private:
+
+        static inline std::uint64_t rotl (std::uint64_t x, int k)
+        {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        std::uint64_t s[4];
+    };
+
+
+
     struct Rand
     {
-        Rand () : generator(std::random_device{}()) {}
+        Rand () : generator((std::uint64_t(std::random_device{}()) << 32) ^ std::random_device{}()) {}
+
+        explicit Rand (std::uint64_t seed) : generator(seed) {}
+
+
+        /// Uniform real number in [0, 1), using the 53 most significant bits
+        inline double unit ()
+        {
+            return (generator() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        /// Uniform integer in [0, range), using the multiply and shift method (no divisions in the common case)
+        inline std::uint32_t below (std::uint32_t range)
+        {
+            std::uint64_t m = (generator() >> 32) * range;
+            std::uint32_t l = std::uint32_t(m);
+
+            if(l < range)
+            {
+                std::uint32_t t = -range % range;
+
+                while(l < t)
+                {
+                    m = (generator() >> 32) * range;
+                    l = std::uint32_t(m);
+                }
+            }
+
+            return std::uint32_t(m >> 32);
+        }
 
-        std::mt19937 generator;
+
+        Xoshiro256 generator;
     };
 
 
     struct RandInt : Rand
     {
+        using Rand::Rand;
+
         inline int operator() (int min, int max)
         {
-            return std::uniform_int_distribution<>(min, max - 1)(generator);
+            return min + int(below(std::uint32_t(max - min)));
+        }
+
+
+        /** Writes 'k' different integers from [0, n) to 'out', all of them also different
+          * from 'exclude' (use a negative value to not exclude anything). It is done by
+          * rejection, so the expected cost only depends on 'k', not on 'n'. Of course,
+          * 'n' must be greater than 'k' (or equal if nothing is excluded).
+        */
+        inline void distinct (int n, int exclude, int* out, int k)
+        {
+            for(int i = 0; i < k; ++i)
+            {
+                bool repeated = true;
+
+                while(repeated)
+                {
+                    out[i] = int(below(std::uint32_t(n)));
+
+                    repeated = (out[i] == exclude);
+
+                    for(int j = 0; j < i && !repeated; ++j)
+                        repeated = (out[i] == out[j]);
+                }
+            }
         }
     };
 
 
     struct RandDouble : Rand
     {
+        using Rand::Rand;
+
         inline double operator() (double min, double max)
         {
-            return std::uniform_real_distribution<>(min, max)(generator);
+            return min + (max - min) * unit();
+        }
+
+
+        /// Fills 'out' with 'n' uniform numbers in [min, max) at once
+        inline void fill (double* out, int n, double min = 0.0, double max = 1.0)
+        {
+            for(int i = 0; i < n; ++i)
+                out[i] = min + (max - min) * unit();
         }
     };
 }
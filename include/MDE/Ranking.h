@@ -0,0 +1,205 @@
+/** \file Ranking.h
+  *
+  * Ranking of candidates by the MDE comparison (see 'help::better'), without
+  * moving the candidates themselves. Only a permutation of indices is sorted.
+  *
+  * Each candidate is encoded as a packed key: a flag telling if it is infeasible
+  * and a 64 bit unsigned integer that increases monotonically with the fitness
+  * (for feasible candidates) or with the violation (for infeasible ones). Two
+  * candidates compare exactly as in 'help::better' if we compare the flags first
+  * and then the integers, so the comparison has no floating point branches and
+  * we can use a radix sort. Example:
+  *
+  * help::Ranking ranking;
+  *
+  * const std::vector<int>& order = ranking(fitness, violation, n);   // 'order[0]' is the best candidate
+  *
+  * int best = help::Ranking::argmin(fitness, violation, n);   // If only the best is needed, there is no sorting
+*/
+
+#ifndef MDE_RANKING_H
+#define MDE_RANKING_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "Vector.h"
+#include "ThreadPool.h"
+
+
+namespace mde
+{
+
+namespace help
+{
+
+/// Unsigned integer with the same order as the double 'x' (for any non NaN value)
+inline std::uint64_t orderedBits (double x)
+{
+    std::uint64_t u;
+
+    std::memcpy(&u, &x, sizeof(double));
+
+    return (u >> 63) ? ~u : (u | (std::uint64_t(1) << 63));
+}
+
+
+
+class Ranking
+{
+public:
+
+    /// Packed key of a candidate. Sorting by '(infeasible, key)' is the same as sorting using 'help::better'
+    struct Item
+    {
+        std::uint64_t key;
+        std::uint32_t infeasible;
+        std::uint32_t index;
+
+        bool operator < (const Item& item) const
+        {
+            return infeasible != item.infeasible ? infeasible < item.infeasible : key < item.key;
+        }
+    };
+
+
+    /// Packs the fitness and violation of the candidate 'index'
+    static Item pack (double fitness, double violation, int index)
+    {
+        return violation == 0.0 ? Item{ orderedBits(fitness), 0, std::uint32_t(index) } :
+                                  Item{ orderedBits(violation), 1, std::uint32_t(index) };
+    }
+
+
+
+    /// Index of the best candidate. No sorting at all, only a linear search
+    static int argmin (const double* fitness, const double* violation, int n)
+    {
+        int b = 0;
+
+        for(int i = 1; i < n; ++i)
+            if(better(fitness[i], violation[i], fitness[b], violation[b]))
+                b = i;
+
+        return b;
+    }
+
+
+
+    /** Returns the indices of the 'n' candidates, from the best to the worst. Ties keep the
+      * original order. Small inputs are sorted by comparison of the packed keys, large ones
+      * with a radix sort. If a 'pool' is given, large inputs are sorted in parallel instead.
+      * The buffers are reused, so nothing is allocated if 'n' does not grow.
+    */
+    const std::vector<int>& operator () (const double* fitness, const double* violation, int n,
+                                         ThreadPool* pool = nullptr)
+    {
+        items.resize(n);
+        buffer.resize(n);
+        order.resize(n);
+
+        for(int i = 0; i < n; ++i)
+            items[i] = pack(fitness[i], violation[i], i);
+
+
+        if(n < radixThreshold)
+            std::stable_sort(items.begin(), items.end());
+
+        else if(pool && pool->size() > 1)
+            parallelSort(*pool);
+
+        else
+            radixSort();
+
+
+        for(int i = 0; i < n; ++i)
+            order[i] = int(items[i].index);
+
+        return order;
+    }
+
+
+    /// Below this size, a comparison sort is faster than the radix sort
+    int radixThreshold = 256;
+
+
+
+private:
+
+    /** Least significant digit radix sort, one byte at a time, and a last pass for the infeasible
+      * flag. Each pass is stable, and passes where every item has the same digit are skipped.
+    */
+    void radixSort ()
+    {
+        const int n = int(items.size());
+
+        std::size_t count[257];
+
+        for(int pass = 0; pass <= 8; ++pass)
+        {
+            std::fill(count, count + 257, 0);
+
+            for(const auto& item : items)
+                count[digit(item, pass) + 1]++;
+
+            if(std::count(count + 1, count + 257, std::size_t(n)))   /// All in the same bucket
+                continue;
+
+            for(int d = 0; d < 256; ++d)
+                count[d + 1] += count[d];
+
+            for(const auto& item : items)
+                buffer[count[digit(item, pass)]++] = item;
+
+            items.swap(buffer);
+        }
+    }
+
+    /// The byte 'pass' of the key, or the infeasible flag in the last pass
+    static int digit (const Item& item, int pass)
+    {
+        return pass < 8 ? int((item.key >> (8 * pass)) & 0xFF) : int(item.infeasible);
+    }
+
+
+    /// Each worker sorts a contiguous chunk, and then the chunks are merged two by two
+    void parallelSort (ThreadPool& pool)
+    {
+        const int n = int(items.size());
+        const int chunks = pool.size();
+
+        auto bound = [&](int c){ return items.begin() + std::size_t(n) * c / chunks; };
+
+        pool.run(chunks, [&](int c, int){ std::stable_sort(bound(c), bound(c + 1)); });
+
+
+        for(int width = 1; width < chunks; width *= 2)
+        {
+            pool.run((chunks + 2 * width - 1) / (2 * width), [&](int m, int)
+            {
+                int first = 2 * width * m, middle = std::min(first + width, chunks), last = std::min(first + 2 * width, chunks);
+
+                std::merge(bound(first), bound(middle), bound(middle), bound(last),
+                           buffer.begin() + (bound(first) - items.begin()));
+            });
+
+            items.swap(buffer);
+        }
+    }
+
+
+
+    std::vector<Item> items;    /// The packed keys
+    std::vector<Item> buffer;   /// Temporary for sorting
+
+    std::vector<int> order;     /// The result
+};
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_RANKING_H
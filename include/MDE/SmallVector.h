@@ -0,0 +1,327 @@
+/** \file SmallVector.h
+  *
+  * A 'std::vector' like container with a small buffer optimization. Up to
+  * 'Inline' elements are stored inside the object itself. Above that, the
+  * elements are stored on the heap. In both cases, the first element is
+  * aligned to a cache line (64 bytes), so it is ready for SIMD loads and
+  * stores. The type itself is not over aligned: the inline buffer has some
+  * slack and the aligned position is computed inside it. This way, it is
+  * safe to put it in a 'std::vector' even before C++17. Example:
+  *
+  * help::SmallVector<double, 16> v(10, 1.0);    // No allocation
+  * help::SmallVector<double, 16> w(100);        // Allocates 100 elements on the heap
+  *
+  * Only trivially copyable types are supported, which is all that 'Vector' needs.
+*/
+
+#ifndef MDE_SMALL_VECTOR_H
+#define MDE_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Aligned.h"
+
+
+namespace mde
+{
+
+namespace help
+{
+
+template <typename T, std::size_t Inline>
+class SmallVector
+{
+public:
+
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types are supported");
+
+
+    using value_type             = T;
+    using size_type              = std::size_t;
+    using difference_type        = std::ptrdiff_t;
+    using reference              = T&;
+    using const_reference        = const T&;
+    using pointer                = T*;
+    using const_pointer          = const T*;
+    using iterator               = T*;
+    using const_iterator         = const T*;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+
+
+    SmallVector () : ptr(local()) {}
+
+    explicit SmallVector (size_type n, const T& value = T{}) : SmallVector()
+    {
+        resize(n, value);
+    }
+
+    SmallVector (std::initializer_list<T> in) : SmallVector(in.begin(), in.end()) {}
+
+    template <class It, typename = std::enable_if_t<!std::is_integral<It>::value>>
+    SmallVector (It first, It last) : SmallVector()
+    {
+        assign(first, last);
+    }
+
+
+    SmallVector (const SmallVector& v) : SmallVector()
+    {
+        assign(v.begin(), v.end());
+    }
+
+    /// Steals the heap block of 'v', if any. Otherwise, copies the inline elements
+    SmallVector (SmallVector&& v) noexcept : SmallVector()
+    {
+        steal(v);
+    }
+
+    SmallVector& operator = (const SmallVector& v)
+    {
+        if(this != &v)
+            assign(v.begin(), v.end());
+
+        return *this;
+    }
+
+    SmallVector& operator = (SmallVector&& v) noexcept
+    {
+        if(this != &v)
+        {
+            release();
+            steal(v);
+        }
+
+        return *this;
+    }
+
+    SmallVector& operator = (std::initializer_list<T> in)
+    {
+        assign(in.begin(), in.end());
+
+        return *this;
+    }
+
+    ~SmallVector ()
+    {
+        release();
+    }
+
+
+
+    /// Copy to a 'std::vector', so functions taking a 'const std::vector<T>&' can still be called
+    operator std::vector<T> () const
+    {
+        return std::vector<T>(begin(), end());
+    }
+
+
+
+    template <class It>
+    void assign (It first, It last)
+    {
+        const size_type n = size_type(std::distance(first, last));
+
+        reserve(n);
+
+        std::copy(first, last, ptr);
+
+        count = n;
+    }
+
+    void assign (size_type n, const T& value)
+    {
+        reserve(n);
+
+        std::fill(ptr, ptr + n, value);
+
+        count = n;
+    }
+
+
+    /// Makes room for 'n' elements, keeping the current ones. The new block is also aligned
+    void reserve (size_type n)
+    {
+        if(n <= cap)
+            return;
+
+        T* block = static_cast<T*>(alignedMalloc(n * sizeof(T)));
+
+        if(count)
+            std::memcpy(block, ptr, count * sizeof(T));
+
+        release();
+
+        ptr = block;
+        cap = n;
+    }
+
+    void resize (size_type n, const T& value = T{})
+    {
+        reserve(n);
+
+        if(n > count)
+            std::fill(ptr + count, ptr + n, value);
+
+        count = n;
+    }
+
+    void push_back (const T& value)
+    {
+        if(count == cap)
+            reserve(std::max(2 * cap, size_type(1)));
+
+        ptr[count++] = value;
+    }
+
+    template <class... Args>
+    T& emplace_back (Args&&... args)
+    {
+        push_back(T(std::forward<Args>(args)...));
+
+        return back();
+    }
+
+    void pop_back () { --count; }
+
+    void clear () { count = 0; }
+
+
+    /// Swaps the contents. Inline elements are copied, heap blocks are exchanged
+    void swap (SmallVector& v)
+    {
+        SmallVector tmp(std::move(v));
+
+        v = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+
+
+    size_type size () const { return count; }
+    size_type capacity () const { return cap; }
+    bool empty () const { return count == 0; }
+
+    static constexpr size_type max_size () { return size_type(-1) / sizeof(T); }
+
+
+    T* data () { return ptr; }
+    const T* data () const { return ptr; }
+
+    T& operator [] (size_type i) { return ptr[i]; }
+    const T& operator [] (size_type i) const { return ptr[i]; }
+
+    T& at (size_type i)
+    {
+        if(i >= count)
+            throw std::out_of_range("SmallVector::at");
+
+        return ptr[i];
+    }
+
+    const T& at (size_type i) const
+    {
+        return const_cast<SmallVector&>(*this).at(i);
+    }
+
+    T& front () { return ptr[0]; }
+    const T& front () const { return ptr[0]; }
+
+    T& back () { return ptr[count - 1]; }
+    const T& back () const { return ptr[count - 1]; }
+
+
+    iterator begin () { return ptr; }
+    iterator end () { return ptr + count; }
+
+    const_iterator begin () const { return ptr; }
+    const_iterator end () const { return ptr + count; }
+
+    const_iterator cbegin () const { return ptr; }
+    const_iterator cend () const { return ptr + count; }
+
+    reverse_iterator rbegin () { return reverse_iterator(end()); }
+    reverse_iterator rend () { return reverse_iterator(begin()); }
+
+    const_reverse_iterator rbegin () const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend () const { return const_reverse_iterator(begin()); }
+
+
+
+    friend bool operator == (const SmallVector& a, const SmallVector& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator != (const SmallVector& a, const SmallVector& b)
+    {
+        return !(a == b);
+    }
+
+
+
+private:
+
+    /// The first aligned position of the inline buffer
+    T* local ()
+    {
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(buffer);
+
+        return reinterpret_cast<T*>((address + cacheLine - 1) & ~std::uintptr_t(cacheLine - 1));
+    }
+
+    bool onHeap () const { return cap > Inline; }
+
+
+    void release ()
+    {
+        if(onHeap())
+            alignedFree(ptr);
+
+        ptr = local();
+        cap = Inline;
+    }
+
+    /// Takes the contents of 'v', which must be empty after this. Assumes that '*this' is on the inline buffer
+    void steal (SmallVector& v)
+    {
+        if(v.onHeap())
+        {
+            ptr = v.ptr;
+            cap = v.cap;
+        }
+
+        else
+            std::memcpy(ptr, v.ptr, v.count * sizeof(T));
+
+        count = v.count;
+
+        v.ptr = v.local();
+        v.cap = Inline;
+        v.count = 0;
+    }
+
+
+
+    T* ptr;                   /// The first element. Points to the inline buffer or to a heap block
+
+    size_type count = 0;      /// Number of elements
+    size_type cap = Inline;   /// Number of elements that fit in 'ptr'
+
+    /// Inline storage. The slack is needed to align the first element
+    T buffer[Inline + (cacheLine + sizeof(T) - 1) / sizeof(T)];
+};
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_SMALL_VECTOR_H
@@ -0,0 +1,378 @@
+/** \file Store.h
+  *
+  * A persistent store of evaluations, kept in a memory mapped file, so the
+  * evaluations of one run are reused by the next ones (with other seeds or
+  * parameters). The file is append-only: each record has the coordinates of a
+  * candidate and its values, and is tagged with a hash of the problem identity
+  * and of the resolution of the keys, so many problems (and runs with other
+  * resolutions) can share the same file. The maximum size of the file is
+  * fixed when it is created, and nothing is added once it is full.
+  *
+  * Many processes (and threads) can use the same file at once. A new record is
+  * claimed with an atomic increment of the counter in the header of the file, and
+  * published with an atomic store of its tag after it is completely written. Each
+  * process keeps its own index of the published records, updated when needed.
+  * Example:
+  *
+  * help::PersistentStore store;
+  *
+  * store.open("evaluations.bin", "g01", N, 2, 1 << 30);    // Up to 1 GB
+  *
+  * std::uint64_t hash = help::candidateKey(x, key, N);
+  *
+  * if(!store.find(key, hash, values))
+  *     store.insert(key, hash, evaluate(x, values));
+  *
+  * Only available on POSIX systems. Elsewhere, 'open' throws.
+*/
+
+#ifndef MDE_STORE_H
+#define MDE_STORE_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define MDE_STORE_POSIX
+    #include <fcntl.h>
+    #include <sys/file.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "Cache.h"
+
+
+namespace mde
+{
+
+namespace help
+{
+
+class PersistentStore
+{
+public:
+
+    PersistentStore () = default;
+
+    PersistentStore (const PersistentStore&) = delete;
+    PersistentStore& operator = (const PersistentStore&) = delete;
+
+    ~PersistentStore ()
+    {
+        close();
+    }
+
+
+    /** Opens (or creates) the file at 'path' for the 'problem', whose candidates have 'N' coordinates and
+      * 'numValues' values. A new file can have up to 'maxBytes' bytes. An existing file keeps its size, and
+      * must have been created for records of the same size. The keys are made with 'resolution' (see
+      * 'candidateKey'), so only the records of the same resolution are found. Throws 'std::runtime_error' on failure.
+    */
+    void open (const std::string& path, const std::string& problem, int N, int numValues, std::size_t maxBytes,
+               double resolution = 0.0)
+    {
+#ifdef MDE_STORE_POSIX
+        close();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        this->N = N;
+        this->numValues = numValues;
+
+        recordBytes = sizeof(Record) + (N + numValues) * sizeof(double);
+        tag = problemTag(problem, N, numValues, resolution);
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+        if(fd < 0)
+            throw std::runtime_error("Could not open the store " + path);
+
+
+        /// Only one process creates the header. The others wait for the lock and then read it
+        ::flock(fd, LOCK_EX);
+
+        struct stat info;
+
+        ::fstat(fd, &info);
+
+        if(info.st_size == 0)
+        {
+            std::size_t capacity = maxBytes > sizeof(Header) ? (maxBytes - sizeof(Header)) / recordBytes : 0;
+
+            Header header{};
+
+            std::memcpy(header.magic, "MDESTORE", 8);
+            header.recordBytes = recordBytes;
+            header.capacity = capacity;
+
+            if(::ftruncate(fd, off_t(sizeof(Header) + capacity * recordBytes)) != 0 ||
+               ::pwrite(fd, &header, sizeof(Header), 0) != ssize_t(sizeof(Header)))
+            {
+                ::flock(fd, LOCK_UN);
+                closeFile();
+                throw std::runtime_error("Could not create the store " + path);
+            }
+
+            ::fstat(fd, &info);
+        }
+
+        ::flock(fd, LOCK_UN);
+
+
+        mappedBytes = std::size_t(info.st_size);
+
+        void* address = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if(address == MAP_FAILED)
+        {
+            closeFile();
+            throw std::runtime_error("Could not map the store " + path);
+        }
+
+        base = static_cast<char*>(address);
+
+        if(std::memcmp(header()->magic, "MDESTORE", 8) != 0 || header()->recordBytes != recordBytes)
+        {
+            closeFile();
+            throw std::runtime_error("The store " + path + " has records of another size");
+        }
+#else
+        (void)path; (void)problem; (void)N; (void)numValues; (void)maxBytes; (void)resolution;
+
+        throw std::runtime_error("The persistent store is only available on POSIX systems");
+#endif
+    }
+
+
+    /// Unmaps and closes the file. The records stay there
+    void close ()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        closeFile();
+    }
+
+    bool isOpen () const { return base != nullptr; }
+
+
+
+    /// If the 'key' (see 'candidateKey') is in the store, copies its values to 'out' and returns true
+    bool find (const double* key, std::uint64_t hash, double* out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!base)
+            return false;
+
+        std::size_t r = lookup(key, hash);
+
+        if(r == npos)    /// Maybe another process added it since the last time
+        {
+            refresh();
+
+            r = lookup(key, hash);
+        }
+
+        if(r == npos)
+        {
+            numMisses++;
+            return false;
+        }
+
+        numHits++;
+
+        const double* values = recordKey(r) + N;
+
+        std::copy(values, values + numValues, out);
+
+        return true;
+    }
+
+
+    /// Appends the 'key' with the values 'in'. Does nothing if it is already there or if the file is full
+    void insert (const double* key, std::uint64_t hash, const double* in)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!base)
+            return;
+
+        refresh();
+
+        if(lookup(key, hash) != npos)
+            return;
+
+        const std::uint64_t r = header()->count.fetch_add(1);
+
+        if(r >= header()->capacity)
+            return;
+
+        record(r)->hash = hash;
+
+        std::copy(key, key + N, recordKey(r));
+        std::copy(in, in + numValues, recordKey(r) + N);
+
+        record(r)->tag.store(tag, std::memory_order_release);    /// Now the other processes can see it. It is indexed by 'refresh'
+    }
+
+
+
+    long hits () const { std::lock_guard<std::mutex> lock(mutex); return numHits; }       /// Number of successful 'find' calls
+    long misses () const { std::lock_guard<std::mutex> lock(mutex); return numMisses; }   /// Number of failed 'find' calls
+
+    /// Number of records of this problem known by this process
+    std::size_t records () const { std::lock_guard<std::mutex> lock(mutex); return index.size(); }
+
+
+
+private:
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The store needs lock free 64 bit atomics to be shared by processes");
+
+
+    /// Beginning of the file
+    struct Header
+    {
+        char magic[8];
+        std::uint64_t recordBytes;            /// Size of each record, including the coordinates and the values
+        std::uint64_t capacity;               /// Maximum number of records
+        std::atomic<std::uint64_t> count;     /// Number of records claimed (may be greater than 'capacity')
+    };
+
+    /// Beginning of each record, followed by the 'N' coordinates and the 'numValues' values
+    struct Record
+    {
+        std::atomic<std::uint64_t> tag;   /// Problem of the record, or 0 while it is being written
+        std::uint64_t hash;               /// Hash of the coordinates
+    };
+
+
+    static constexpr std::size_t npos = std::size_t(-1);
+
+
+    Header* header () const { return reinterpret_cast<Header*>(base); }
+
+    Record* record (std::size_t r) const { return reinterpret_cast<Record*>(base + sizeof(Header) + r * recordBytes); }
+
+    double* recordKey (std::size_t r) const { return reinterpret_cast<double*>(record(r) + 1); }
+
+
+    /** Hash of the problem identity and of the resolution of the keys, since a rounded key means another thing
+      * than an exact one. Never 0, which marks a record being written.
+    */
+    static std::uint64_t problemTag (const std::string& problem, int N, int numValues, double resolution)
+    {
+        std::uint64_t h = mixBits(std::uint64_t(N) << 32 | std::uint32_t(numValues));
+
+        for(unsigned char c : problem)
+            h = mixBits(h ^ c);
+
+        if(resolution > 0.0)    /// The exact keys keep the tag they had before the resolution was part of it
+        {
+            std::uint64_t bits;
+
+            std::memcpy(&bits, &resolution, sizeof(double));
+
+            h = mixBits(h ^ bits);
+        }
+
+        return h ? h : 1;
+    }
+
+
+    /// The record with the given key in the index, or 'npos'
+    std::size_t lookup (const double* key, std::uint64_t hash) const
+    {
+        auto range = index.equal_range(hash);
+
+        for(auto it = range.first; it != range.second; ++it)
+            if(std::equal(key, key + N, recordKey(it->second)))
+                return it->second;
+
+        return npos;
+    }
+
+
+    /** Adds to the index the records published since the last call, including the ones of this process. A record
+      * claimed but not published yet is checked again in the next calls.
+    */
+    void refresh ()
+    {
+        const std::size_t count = std::min<std::uint64_t>(header()->count.load(), header()->capacity);
+
+        for(std::size_t r = scanned; r < count; ++r)
+            pending.push_back(r);
+
+        scanned = std::max(scanned, count);
+
+        auto published = [this](std::size_t r)
+        {
+            const std::uint64_t t = record(r)->tag.load(std::memory_order_acquire);
+
+            if(t == tag)
+                index.emplace(record(r)->hash, r);
+
+            return t != 0;
+        };
+
+        pending.erase(std::remove_if(pending.begin(), pending.end(), published), pending.end());
+    }
+
+
+    void closeFile ()
+    {
+#ifdef MDE_STORE_POSIX
+        if(base)
+            ::munmap(base, mappedBytes);
+
+        if(fd >= 0)
+            ::close(fd);
+#endif
+
+        base = nullptr;
+        fd = -1;
+        mappedBytes = scanned = 0;
+
+        index.clear();
+        pending.clear();
+
+        numHits = numMisses = 0;
+    }
+
+
+
+    int fd = -1;                     /// File descriptor
+    char* base = nullptr;            /// Beginning of the mapping
+    std::size_t mappedBytes = 0;
+
+    int N = 0;                       /// Number of coordinates of each record
+    int numValues = 0;               /// Number of values of each record
+    std::size_t recordBytes = 0;
+    std::uint64_t tag = 0;           /// Tag of the problem
+
+    std::unordered_multimap<std::uint64_t, std::size_t> index;   /// Records of this problem, by hash
+
+    std::size_t scanned = 0;             /// Records before this one were already seen by 'refresh'
+    std::vector<std::size_t> pending;    /// Records claimed but not yet published when last seen
+
+    long numHits = 0;
+    long numMisses = 0;
+
+    mutable std::mutex mutex;
+};
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_STORE_H
@@ -0,0 +1,595 @@
+/** \file Subprocess.h
+  *
+  * Evaluation by a pool of long-lived worker processes, for functions that are
+  * external programs (simulators, for example). The workers are started once and
+  * receive the candidates through their standard input, answering through their
+  * standard output, so there is no process startup cost per evaluation. A block
+  * of candidates (see 'mde::Batch') is split in chunks, sent to the idle workers
+  * as soon as they finish the previous chunk. All the workers are driven by a
+  * single thread, without blocking on any of them.
+  *
+  * The protocol is binary, in the native byte order. A request has four 32 bit
+  * unsigned integers: the number of candidates 'count', the number of variables
+  * 'N', the number of inequalities and of equalities of each candidate. Then, the
+  * 'count * N' variables (as doubles). The answer has, for each candidate, its
+  * fitness, inequalities and equalities values (as doubles). 'serveSubprocess'
+  * implements the worker side for a C++ program. It stops at a request whose
+  * sizes are not the ones of its problem.
+  *
+  * If a worker takes more than 'timeout' seconds per candidate, or closes its
+  * output (because it crashed, for example), it is killed and started again. The
+  * candidates of its chunk are retried one by one, and a candidate that fails
+  * twice alone gets an infinite fitness and infinite constraints values. Example:
+  *
+  * struct Simulator : mde::Function<>
+  * {
+  *     void evaluateBatch (mde::Batch& batch) { pool->evaluate(batch); }
+  *
+  *     std::shared_ptr<mde::SubprocessPool> pool = std::make_shared<mde::SubprocessPool>(
+  *         std::vector<std::string>{ "./simulator", "--binary" }, 8, 60.0);    // 8 workers, 60 s per candidate
+  * };
+  *
+  * Only available on POSIX systems. Elsewhere, the constructor throws.
+*/
+
+#ifndef MDE_SUBPROCESS_H
+#define MDE_SUBPROCESS_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define MDE_SUBPROCESS_POSIX
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#include "Function.h"
+
+
+namespace mde
+{
+
+namespace help
+{
+
+/// Copies the fitness and constraints values of the candidate 'k' of 'batch' from 'values'
+inline void storeValues (Batch& batch, int k, const double* values)
+{
+    batch.fitness[k] = values[0];
+
+    std::copy(values + 1, values + 1 + batch.numInequalities, batch.inequalities + std::ptrdiff_t(k) * batch.numInequalities);
+    std::copy(values + 1 + batch.numInequalities, values + 1 + batch.numInequalities + batch.numEqualities,
+              batch.equalities + std::ptrdiff_t(k) * batch.numEqualities);
+}
+
+
+#ifdef MDE_SUBPROCESS_POSIX
+
+/// Flag for 'send', so writing to a closed connection fails instead of raising 'SIGPIPE'
+#if defined(MSG_NOSIGNAL)
+constexpr int noSignal = MSG_NOSIGNAL;
+#else
+constexpr int noSignal = 0;
+#endif
+
+
+/// Largest request accepted by 'serveRequests', in bytes of variables and values
+constexpr std::uint64_t maxRequestBytes = std::uint64_t(1) << 30;
+
+
+/** Answers the requests read from 'input' (see the protocol at the beginning of the file), writing to 'output',
+  * until the input ends. See 'serveSubprocess'. The same descriptor can be given twice (a socket, for example).
+  * Returns 1 if a request has other sizes than 'N', 'numInequalities' and 'numEqualities', no candidates, or
+  * more than 'maxRequestBytes' bytes, without evaluating it.
+*/
+template <class F>
+int serveRequests (int input, int output, F& f, int N, int numInequalities, int numEqualities)
+{
+    auto readAll = [input](void* data, std::size_t bytes)
+    {
+        for(char* p = static_cast<char*>(data); bytes; )
+        {
+            const ssize_t n = ::read(input, p, bytes);
+
+            if(n <= 0 && !(n < 0 && errno == EINTR))
+                return false;
+
+            if(n > 0)
+                p += n, bytes -= std::size_t(n);
+        }
+
+        return true;
+    };
+
+    auto writeAll = [output](const void* data, std::size_t bytes)
+    {
+        for(const char* p = static_cast<const char*>(data); bytes; )
+        {
+            ssize_t n = ::send(output, p, bytes, noSignal);
+
+            if(n < 0 && errno == ENOTSOCK)
+                n = ::write(output, p, bytes);
+
+            if(n < 0 && errno != EINTR)
+                return false;
+
+            if(n > 0)
+                p += n, bytes -= std::size_t(n);
+        }
+
+        return true;
+    };
+
+
+    std::vector<double> x, values;
+    std::uint32_t header[4];
+
+    const std::uint64_t rowBytes = std::uint64_t(N + 1 + numInequalities + numEqualities) * sizeof(double);
+
+    while(readAll(header, sizeof(header)))
+    {
+        if(header[0] == 0 || header[0] * rowBytes > maxRequestBytes || header[1] != std::uint32_t(N) ||
+           header[2] != std::uint32_t(numInequalities) || header[3] != std::uint32_t(numEqualities))
+            return 1;
+
+        const int count = int(header[0]);
+
+        x.resize(std::size_t(count) * N);
+        values.resize(std::size_t(count) * (1 + numInequalities + numEqualities));
+
+        if(!readAll(x.data(), x.size() * sizeof(double)))
+            return 1;
+
+        for(int k = 0; k < count; ++k)
+        {
+            double* v = values.data() + std::size_t(k) * (1 + numInequalities + numEqualities);
+
+            v[0] = f(x.data() + std::size_t(k) * N, N, v + 1, v + 1 + numInequalities);
+        }
+
+        if(!writeAll(values.data(), values.size() * sizeof(double)))
+            return 1;
+    }
+
+    return 0;
+}
+
+#endif
+
+} // namespace help
+
+
+
+class SubprocessPool
+{
+public:
+
+    /** Starts 'numWorkers' processes running 'command' (the program, then its arguments, searched in the 'PATH').
+      * With a positive 'timeout', a worker that takes more than 'timeout' seconds per candidate is restarted. Each
+      * request has up to 'chunk' candidates. With 0, a block is split evenly between the workers.
+    */
+    SubprocessPool (const std::vector<std::string>& command, int numWorkers, double timeout = 0.0, int chunk = 0) :
+                    command(command), timeout(timeout), chunk(chunk)
+    {
+        start(numWorkers);
+    }
+
+    /** Same as above, but each worker is a copy of this process (made with 'fork', without 'exec') running 'serve',
+      * whose standard input and output are the connection. The worker exits when 'serve' returns. As only the calling
+      * thread is copied, 'serve' must not depend on other threads. Usually, it calls 'serveSubprocess'.
+    */
+    SubprocessPool (std::function<int()> serve, int numWorkers, double timeout = 0.0, int chunk = 0) :
+                    serve(std::move(serve)), timeout(timeout), chunk(chunk)
+    {
+        start(numWorkers);
+    }
+
+    SubprocessPool (const SubprocessPool&) = delete;
+    SubprocessPool& operator = (const SubprocessPool&) = delete;
+
+
+    /// Closes the connections, so the workers exit. A worker still running after a second is killed
+    ~SubprocessPool ()
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        for(auto& worker : workers)
+            if(worker.fd >= 0)
+                ::close(worker.fd), worker.fd = -1;
+
+        const auto deadline = Clock::now() + std::chrono::seconds(1);
+
+        for(auto& worker : workers)
+        {
+            while(worker.pid > 0 && Clock::now() < deadline)
+            {
+                if(::waitpid(worker.pid, nullptr, WNOHANG) != 0)
+                    worker.pid = -1;    /// Exited (or not ours anymore), so it must not be killed
+
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            stop(worker);
+        }
+#endif
+    }
+
+
+
+    /** Evaluates every candidate of 'batch' in the workers, writing the fitness and the constraints values. It only
+      * returns when every candidate is done (or failed, see the beginning of the file).
+    */
+    void evaluate (Batch& batch)
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const int numValues = 1 + batch.numInequalities + batch.numEqualities;
+        const int perChunk = chunk > 0 ? chunk : std::max(1, (batch.count + int(workers.size()) - 1) / int(workers.size()));
+
+        tasks.clear();
+
+        for(int first = 0; first < batch.count; first += perChunk)
+            tasks.push_back(Task{ first, std::min(perChunk, batch.count - first), 0 });
+
+        std::reverse(tasks.begin(), tasks.end());    /// Taken from the back, so in order
+
+        int busy = 0;
+
+        while(busy > 0 || !tasks.empty())
+        {
+            /// Give a chunk to every idle worker
+            for(auto& worker : workers)
+            {
+                if(worker.busy || tasks.empty())
+                    continue;
+
+                send(worker, batch, tasks.back());
+                tasks.pop_back();
+                busy++;
+            }
+
+
+            /// Wait until some worker can be written, has something to read, or its deadline passes
+            polls.clear();
+
+            long long wait = -1;    /// Milliseconds until the nearest deadline, or forever
+
+            for(auto& worker : workers)
+            {
+                if(!worker.busy)
+                    continue;
+
+                short events = POLLIN;
+
+                if(worker.written < worker.out.size())
+                    events |= POLLOUT;
+
+                polls.push_back(pollfd{ worker.fd, events, 0 });
+
+                if(timeout > 0.0)
+                {
+                    const long long left = std::max<long long>(0, 1 + std::chrono::duration_cast<std::chrono::milliseconds>(worker.deadline - Clock::now()).count());
+
+                    wait = wait < 0 ? left : std::min(wait, left);
+                }
+            }
+
+            ::poll(polls.data(), polls.size(), int(std::min<long long>(wait, std::numeric_limits<int>::max())));
+
+
+            for(std::size_t p = 0, w = 0; p < polls.size(); ++w)
+            {
+                Worker& worker = workers[w];
+
+                if(!worker.busy)
+                    continue;
+
+                const short events = polls[p++].revents;
+
+                bool failed = false;
+
+                if(events & POLLOUT)
+                    failed = !write(worker);
+
+                if(!failed && (events & (POLLIN | POLLHUP | POLLERR)))
+                    failed = !read(worker);
+
+                if(!failed && worker.received == worker.in.size() && worker.written == worker.out.size())
+                {
+                    const double* values = reinterpret_cast<const double*>(worker.in.data());
+
+                    for(int k = 0; k < worker.task.count; ++k)
+                        help::storeValues(batch, worker.task.first + k, values + std::size_t(k) * numValues);
+
+                    worker.busy = false;
+                    busy--;
+                }
+
+                else if(failed || (timeout > 0.0 && Clock::now() > worker.deadline))
+                {
+                    fail(worker, batch);
+                    busy--;
+                }
+            }
+        }
+#else
+        (void)batch;
+#endif
+    }
+
+
+
+    /// Number of workers restarted because of a timeout or a failure
+    long restarts () const { return numRestarts; }
+
+    /// Number of candidates that failed twice alone, and got infinite values
+    long failures () const { return numFailures; }
+
+    int size () const { return int(workers.size()); }
+
+
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+
+    /// Candidates [first, first + count) of the current block. 'attempts' counts the failures of a single candidate
+    struct Task
+    {
+        int first;
+        int count;
+        int attempts;
+    };
+
+    struct Worker
+    {
+        int pid = -1;
+        int fd = -1;    /// Our end of the connection
+
+        bool busy = false;
+        Task task{ 0, 0, 0 };
+        Clock::time_point deadline;
+
+        std::vector<char> out;       /// Request being written, and how much of it was
+        std::size_t written = 0;
+
+        std::vector<char> in;        /// Answer being read, and how much of it was
+        std::size_t received = 0;
+    };
+
+
+
+    void start (int numWorkers)
+    {
+#ifdef MDE_SUBPROCESS_POSIX
+        for(const auto& arg : command)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+
+        argv.push_back(nullptr);
+
+        workers.resize(std::max(1, numWorkers));
+
+        for(auto& worker : workers)
+            spawn(worker);
+#else
+        (void)numWorkers;
+
+        throw std::runtime_error("The pool of subprocesses is only available on POSIX systems");
+#endif
+    }
+
+
+#ifdef MDE_SUBPROCESS_POSIX
+
+    /** Starts the process of 'worker', connected by a pair of sockets (a bidirectional pipe, that doesn't raise
+      * 'SIGPIPE' when the worker dies). Our ends are closed in the new process, so each worker sees the end of
+      * its input only when we close it.
+    */
+    void spawn (Worker& worker)
+    {
+        int fds[2];
+
+        if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            throw std::runtime_error("Could not create the connection to a worker");
+
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+        const int pid = ::fork();
+
+        if(pid < 0)
+        {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            throw std::runtime_error("Could not start a worker");
+        }
+
+        if(pid == 0)
+        {
+            for(const auto& other : workers)
+                if(other.fd >= 0)
+                    ::close(other.fd);
+
+            ::dup2(fds[1], 0);
+            ::dup2(fds[1], 1);
+            ::close(fds[0]);
+            ::close(fds[1]);
+
+            if(serve)
+                ::_exit(serve());
+
+            ::execvp(argv[0], argv.data());
+            ::_exit(127);
+        }
+
+        ::close(fds[1]);
+
+        worker.pid = pid;
+        worker.fd = fds[0];
+        worker.busy = false;
+    }
+
+    /// Kills the process of 'worker'
+    void stop (Worker& worker)
+    {
+        if(worker.fd >= 0)
+            ::close(worker.fd);
+
+        if(worker.pid > 0)
+        {
+            ::kill(worker.pid, SIGKILL);
+            ::waitpid(worker.pid, nullptr, 0);
+        }
+
+        worker.fd = worker.pid = -1;
+    }
+
+
+    /// Prepares the request of the candidates of 'task'. It is written by 'write' when the connection can take it
+    void send (Worker& worker, const Batch& batch, const Task& task)
+    {
+        const std::uint32_t header[4] = { std::uint32_t(task.count), std::uint32_t(batch.N),
+                                          std::uint32_t(batch.numInequalities), std::uint32_t(batch.numEqualities) };
+
+        worker.out.resize(sizeof(header) + std::size_t(task.count) * batch.N * sizeof(double));
+
+        std::memcpy(worker.out.data(), header, sizeof(header));
+
+        for(int k = 0; k < task.count; ++k)
+            std::memcpy(worker.out.data() + sizeof(header) + std::size_t(k) * batch.N * sizeof(double), batch[task.first + k], batch.N * sizeof(double));
+
+        worker.in.resize(std::size_t(task.count) * (1 + batch.numInequalities + batch.numEqualities) * sizeof(double));
+
+        worker.written = worker.received = 0;
+        worker.task = task;
+        worker.busy = true;
+        worker.deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout * task.count));
+    }
+
+    /// Writes as much of the request as possible without blocking. Returns false if the worker is gone
+    bool write (Worker& worker)
+    {
+        const ssize_t n = ::send(worker.fd, worker.out.data() + worker.written, worker.out.size() - worker.written, MSG_DONTWAIT | help::noSignal);
+
+        if(n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        worker.written += std::size_t(n);
+
+        return true;
+    }
+
+    /// Reads as much of the answer as possible without blocking. Returns false if the worker is gone or sent too much
+    bool read (Worker& worker)
+    {
+        if(worker.received == worker.in.size())    /// Anything more is not part of the protocol
+        {
+            char extra;
+
+            return ::recv(worker.fd, &extra, 1, MSG_DONTWAIT | MSG_PEEK) < 0 && errno == EAGAIN;
+        }
+
+        const ssize_t n = ::recv(worker.fd, worker.in.data() + worker.received, worker.in.size() - worker.received, MSG_DONTWAIT);
+
+        if(n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        worker.received += std::size_t(n);
+
+        return n > 0;    /// 0 is the end of the connection
+    }
+
+
+    /** The worker failed during its chunk, so it is started again. The candidates of a chunk are retried one by
+      * one, and a single candidate is retried once. Then, it gets infinite values.
+    */
+    void fail (Worker& worker, Batch& batch)
+    {
+        const Task task = worker.task;
+
+        stop(worker);
+        spawn(worker);
+
+        numRestarts++;
+
+        if(task.count > 1)
+            for(int k = task.count - 1; k >= 0; --k)
+                tasks.push_back(Task{ task.first + k, 1, 0 });
+
+        else if(task.attempts + 1 < 2)
+            tasks.push_back(Task{ task.first, 1, task.attempts + 1 });
+
+        else
+        {
+            numFailures++;
+
+            failed.assign(1 + batch.numInequalities + batch.numEqualities, std::numeric_limits<double>::infinity());
+
+            help::storeValues(batch, task.first, failed.data());
+        }
+    }
+
+#endif
+
+
+    std::vector<std::string> command;   /// Program and arguments of the workers, if they are not made by 'serve'
+    std::vector<char*> argv;
+
+    std::function<int()> serve;   /// Main function of the workers, if they are copies of this process
+
+    double timeout;   /// Seconds per candidate. Not used if not positive
+    int chunk;        /// Candidates per request. See the constructor
+
+    std::vector<Worker> workers;
+
+    std::vector<Task> tasks;          /// Chunks not given to any worker yet, the next one at the back
+    std::vector<pollfd> polls;        /// Connections waited for by 'evaluate'
+    std::vector<double> failed;       /// Values of a failed candidate
+
+    long numRestarts = 0;
+    long numFailures = 0;
+
+    std::mutex mutex;    /// Only one 'evaluate' at a time
+};
+
+
+
+#ifdef MDE_SUBPROCESS_POSIX
+
+/** Main loop of a worker written in C++, for a problem with 'N' variables, 'numInequalities' inequalities and
+  * 'numEqualities' equalities. Reads the requests of a 'SubprocessPool' from the standard input and writes the
+  * answers to the standard output, until the input ends. For each candidate, it calls:
+  *
+  * double f (const double* x, int N, double* inequalities, double* equalities)
+  *
+  * which returns the fitness and writes the constraints values. Returns 0 when the input ends, and 1 if a request
+  * is truncated, can't be answered or has other sizes.
+*/
+template <class F>
+int serveSubprocess (int N, int numInequalities, int numEqualities, F f)
+{
+    return help::serveRequests(0, 1, f, N, numInequalities, numEqualities);
+}
+
+#endif
+
+} // namespace mde
+
+
+#endif // MDE_SUBPROCESS_H
@@ -0,0 +1,272 @@
+/** \file ThreadPool.h
+  *
+  * A small persistent pool of worker threads. The threads are created only
+  * once and then reused for every call to 'run', so there is no thread creation
+  * cost per generation of MDE. Example:
+  *
+  * help::ThreadPool pool(4);    // 3 extra threads + the calling thread
+  *
+  * pool.run(100, [&](int i, int worker){ ... });   // Calls the function for i in [0, 100)
+  *
+  * The 'worker' argument is in the range [0, pool.size()) and is unique for every
+  * thread running at the same time, so it can be used to index per thread data
+  * (random generators, temporary vectors, etc). The calling thread is always
+  * the worker 0, and 'run' only returns when every index was processed. A 'run'
+  * called from a task of the same pool (a parallel reduction inside an evaluation,
+  * while the pool evaluates many candidates) is done by the calling thread alone.
+  *
+  * There is also a 'SpinLock', for the short critical sections of the asynchronous mode of MDE.
+*/
+
+#ifndef MDE_THREAD_POOL_H
+#define MDE_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+
+
+namespace mde
+{
+
+namespace help
+{
+
+class ThreadPool
+{
+public:
+
+    /// If 'numThreads' is not positive, use all the available cores
+    explicit ThreadPool (int numThreads = 0)
+    {
+        if(numThreads <= 0)
+            numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+
+        /// The calling thread also works, so we only need 'numThreads - 1' extra threads
+        for(int id = 1; id < numThreads; ++id)
+            threads.emplace_back([this, id]{ loop(id); });
+    }
+
+    ~ThreadPool ()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        start.notify_all();
+
+        for(auto& t : threads)
+            t.join();
+    }
+
+    ThreadPool (const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+
+
+    /// Number of workers, including the calling thread
+    int size () const { return int(threads.size()) + 1; }
+
+
+
+    /// True if the calling thread is running a task of this pool
+    bool busy () const { return current() == this; }
+
+
+
+    /** Calls 'f(i, worker)' for every 'i' in [0, count). The indices are distributed
+      * dynamically, so expensive and cheap tasks are balanced between the workers.
+      * The first exception thrown by any task is rethrown here, after all the workers stopped.
+      *
+      * If called from a task of this pool, every worker is already busy, so the indices are
+      * processed in order by the calling thread, with its own 'worker'. So nested parallel
+      * loops never oversubscribe the cores (nor wait for themselves).
+    */
+    template <class F>
+    void run (int count, F&& f)
+    {
+        if(busy())
+        {
+            for(int i = 0; i < count; ++i)
+                f(i, currentWorker());
+
+            return;
+        }
+
+        /// Only one job at a time. Other threads calling 'run' simply wait
+        std::lock_guard<std::mutex> runLock(runMutex);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            job = static_cast<const void*>(&f);
+            invoke = [](const void* job, int i, int worker){ (*static_cast<std::remove_reference_t<F>*>(const_cast<void*>(job)))(i, worker); };
+
+            total = count;
+            next = 0;
+            pending = int(threads.size());
+            error = nullptr;
+            ++epoch;
+        }
+
+        start.notify_all();
+
+        work(0);    /// The calling thread is the worker 0
+
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        done.wait(lock, [this]{ return pending == 0; });
+
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+
+
+private:
+
+    /// Take indices until there is nothing left. The calling thread may be in a task of another pool, so that is restored at the end
+    void work (int worker)
+    {
+        const ThreadPool* outerPool = current();
+        const int outerWorker = currentWorker();
+
+        current() = this;
+        currentWorker() = worker;
+
+        try
+        {
+            for(int i = next++; i < total; i = next++)
+                invoke(job, i, worker);
+        }
+
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if(!error)
+                error = std::current_exception();
+
+            next = total;   /// Make the other workers stop as soon as possible
+        }
+
+        current() = outerPool;
+        currentWorker() = outerWorker;
+    }
+
+
+    /// The pool whose task the calling thread is running, if any, and its worker index there
+    static const ThreadPool*& current ()
+    {
+        static thread_local const ThreadPool* pool = nullptr;
+
+        return pool;
+    }
+
+    static int& currentWorker ()
+    {
+        static thread_local int worker = 0;
+
+        return worker;
+    }
+
+
+    /// Main loop of the extra threads. Wait for a new job, work on it and notify when finished
+    void loop (int worker)
+    {
+        std::size_t seen = 0;
+
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                start.wait(lock, [&]{ return stop || epoch != seen; });
+
+                if(stop)
+                    return;
+
+                seen = epoch;
+            }
+
+            work(worker);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if(--pending == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+
+
+    std::vector<std::thread> threads;   /// Extra threads. The calling thread is not here
+
+    std::mutex mutex;       /// Guards the job state below
+    std::mutex runMutex;    /// Serializes concurrent calls to 'run'
+
+    std::condition_variable start;   /// Notifies the workers about a new job
+    std::condition_variable done;    /// Notifies 'run' that all the workers finished
+
+
+    const void* job = nullptr;                      /// The current function, type erased
+    void (*invoke)(const void*, int, int) = nullptr;   /// Calls 'job' with the correct type
+
+    int total = 0;                  /// Number of indices of the current job
+    std::atomic<int> next{0};       /// Next index to be processed
+    int pending = 0;                /// Number of extra threads still working on the current job
+    std::size_t epoch = 0;          /// Incremented at every new job
+    bool stop = false;              /// Set on destruction
+
+    std::exception_ptr error;       /// First exception thrown by the current job
+};
+
+
+
+/** A lock for very short critical sections, like copying a row of the population. It spins (yielding
+  * the processor) instead of sleeping. A copy is a new, unlocked, lock, so it can be kept in a 'std::vector'.
+*/
+class SpinLock
+{
+public:
+
+    SpinLock () = default;
+
+    SpinLock (const SpinLock&) {}
+
+    SpinLock& operator = (const SpinLock&) { return *this; }
+
+
+    void lock ()
+    {
+        while(locked.exchange(true, std::memory_order_acquire))
+            while(locked.load(std::memory_order_relaxed))
+                std::this_thread::yield();
+    }
+
+    void unlock ()
+    {
+        locked.store(false, std::memory_order_release);
+    }
+
+
+private:
+
+    std::atomic<bool> locked{ false };
+};
+
+} // namespace help
+
+} // namespace mde
+
+
+#endif // MDE_THREAD_POOL_H
@@ -1,12 +1,13 @@
 /** \file Vector.h
   *
   * General 'Vector' type containing information about fitness and
-  * constraints values. If the size is specified at compile time, the
-  * class will inherit from 'std::array'. Otherwise, it will inherit
-  * from 'std::vector'. Also, if the size specified at compile time is 
-  * too big, we use a 'std::vector' to avoid stack overflow. Some
-  * construtor definitions were made to make the interface of
-  * 'std::array' compatible.
+  * constraints values. If the size is specified at compile time and it is
+  * small (up to 'SelectType::maxBytes' bytes), the class will inherit from
+  * 'std::array'. Otherwise, it will inherit from 'help::SmallVector', which
+  * keeps a few elements inline and the rest on the heap, always aligned to
+  * a cache line. So a 'Vector' never puts a large array on the stack. Some
+  * construtor definitions were made to make the interface of 'std::array'
+  * compatible, and 'help::SmallVector' has the same interface of 'std::vector'.
   *
 */
 
@@ -17,6 +18,10 @@
 #include <type_traits>
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <initializer_list>
+
+#include "SmallVector.h"
 
 namespace mde
 {
@@ -24,14 +29,17 @@ namespace mde
 namespace help
 {
 
-/// Selects 'std::array' if '(N == 0 || N >= maxSize * sizeof(T)'. Else, selects 'std::vector'
+/// Selects 'std::array' if 'N != 0' and it takes at most 'maxBytes' bytes. Else, selects 'help::SmallVector'
 template<typename T, std::size_t N>
 struct SelectType
 {
-    /// Maximum size to allow the creation of 'Vector' on the stack.
-    static constexpr std::size_t maxSize = 10000 * sizeof(char);
+    /// Maximum size, in bytes, to allow the creation of 'Vector' on the stack.
+    static constexpr std::size_t maxBytes = 4096;
+
+    /// Number of elements stored inline by 'help::SmallVector'. Larger vectors go to the heap
+    static constexpr std::size_t inlineSize = 16;
 
-    using type = std::conditional_t<(N == 0 || N >= maxSize * sizeof(T)), std::vector<T>, std::array<T, N>>;
+    using type = std::conditional_t<(N == 0 || N * sizeof(T) > maxBytes), SmallVector<T, inlineSize>, std::array<T, N>>;
 };
 
 /// Alias
@@ -44,18 +52,23 @@ using SelectType_t = typename SelectType<T, N>::type;
 template<typename T, std::size_t N = 0>
 struct VectorBase : public SelectType_t<T, N>
 {
-    /// Inherits all constructors of std::vector, given that std::array has no constructor
+    /// Inherits all constructors of 'help::SmallVector', given that std::array has no constructor
     using Base = SelectType_t<T, N>;
     using Base::Base;
 
 
     /// Just for convenience
     static constexpr bool isArray =  std::is_same<std::array<T, N>, Base>::value;
-    static constexpr bool isVector = std::is_same<std::vector<T>, Base>::value;
+    static constexpr bool isVector = !isArray;
 
 
 
-    VectorBase() : Base() {}
+    /// If the size is given at compile time, the 'Vector' always has 'N' elements, even if it is on the heap
+    VectorBase() : Base()
+    {
+        if(N && isVector)
+            resizeTo(static_cast<Base&>(*this), N);
+    }
 
     /// Constructor needed for list initialization if inheriting from std::array
     template<typename U = Base, typename = std::enable_if_t<std::is_same<std::array<T, N>, U>::value>>
@@ -70,11 +83,38 @@ struct VectorBase : public SelectType_t<T, N>
     {
         std::fill(this->begin(), this->end(), t);
     }
+
+
+private:
+
+    template <class V>
+    static void resizeTo (V& v, std::size_t n) { v.resize(n); }
+
+    static void resizeTo (std::array<T, N>&, std::size_t) {}
 };
 
 
 
 
+/** The comparison used in MDE, given only the fitness and violation values of two
+  * candidates. Returns true if the first one is better. See 'Vector::operator<'.
+*/
+inline bool better (double fitnessA, double violationA, double fitnessB, double violationB)
+{
+    if(violationA == 0.0 && violationB == 0.0)
+        return fitnessA < fitnessB;
+
+    if(violationA == 0.0)
+        return true;
+
+    if(violationB == 0.0)
+        return false;
+
+    return violationA < violationB;
+}
+
+
+
 /** The actual 'Vector' class. Uses 'double' and stores both
   * fitness and violation values, initially set to a very large
   * value (1e18), so that this vector is worst than anything.
@@ -98,16 +138,7 @@ struct Vector : public help::VectorBase<double, N>
     */
     bool operator < (const Vector& x) const
     {
-        if(this->feasible() && x.feasible())
-            return this->fitness < x.fitness;
-
-        if(this->feasible())
-            return true;
-
-        if(x.feasible())
-            return false;
-
-        return this->violation < x.violation;
+        return better(this->fitness, this->violation, x.fitness, x.violation);
     }
     
 
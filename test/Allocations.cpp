@@ -0,0 +1,36 @@
+/** \file Allocations.cpp
+  *
+  * Replaces the global 'operator new' to count the heap allocations made while
+  * 'countAllocations' is set. It is kept in its own file so the replacement
+  * is not visible (and inlined) in the tests themselves.
+*/
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+
+std::atomic<bool> countAllocations{false};
+std::atomic<long> allocations{0};
+
+
+void* operator new (std::size_t size)
+{
+	if(countAllocations)
+		allocations++;
+
+	if(void* p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete (void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete (void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
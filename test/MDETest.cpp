@@ -1,13 +1,35 @@
 #include <cmath>
+#include <atomic>
+#include <numeric>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <fstream>
+#include <cstdio>
+#include <future>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "gtest/gtest.h"
 #include "MDE/MDE.h"
+#include "MDE/Islands.h"
+#include "MDE/ProcessIslands.h"
+#include "MDE/Subprocess.h"
+#include "MDE/Distributed.h"
 #include "CEC2006/CEC2006.h"
 
 using namespace mde;
 using namespace mde::CEC2006;
 
 
+/// Counts the heap allocations made while 'countAllocations' is set. See 'Allocations.cpp'
+extern std::atomic<bool> countAllocations;
+extern std::atomic<long> allocations;
+
+
 #define TEST_FUNCTION(FUNC)       		  \
 							      		  \
 TEST_F(MDETest, FUNC)         	  		  \
@@ -171,6 +193,285 @@ struct ConstRosenbrock : mde::Function<>
 
 
 
+/// Same as 'ConstRosenbrock', but evaluating many candidates at once
+struct BatchConstRosenbrock : ConstRosenbrock
+{
+	BatchConstRosenbrock ()
+	{
+		numInequalities = 1;
+	}
+
+	void evaluateBatch (mde::Batch& batch)
+	{
+		calls++;
+		largest = std::max(largest, batch.count);
+
+		for(int k = 0; k < batch.count; ++k)
+		{
+			const double* x = batch[k];
+
+			batch.fitness[k] = 100.0 * std::pow(x[1] - x[0] * x[0], 2) + std::pow(1.0 - x[0], 2);
+			batch.inequalities[k] = std::pow(x[0] - 1.0/3, 2) + std::pow(x[1] - 1.0/3, 2) - std::pow(1.0/3, 2);
+		}
+	}
+
+	int calls = 0;
+	int largest = 0;
+};
+
+
+
+
+/// Same as 'ConstRosenbrock', but evaluated by worker processes
+struct SubprocessConstRosenbrock : ConstRosenbrock
+{
+	SubprocessConstRosenbrock ()
+	{
+		numInequalities = 1;
+	}
+
+	void evaluateBatch (mde::Batch& batch)
+	{
+		pool->evaluate(batch);
+	}
+
+	static int serve ()
+	{
+		return mde::serveSubprocess(2, 1, 0, [](const double* x, int, double* inequalities, double*)
+		{
+			inequalities[0] = std::pow(x[0] - 1.0/3, 2) + std::pow(x[1] - 1.0/3, 2) - std::pow(1.0/3, 2);
+
+			return 100.0 * std::pow(x[1] - x[0] * x[0], 2) + std::pow(1.0 - x[0], 2);
+		});
+	}
+
+	std::shared_ptr<mde::SubprocessPool> pool = std::make_shared<mde::SubprocessPool>(serve, 2);
+};
+
+
+
+/// Same as 'ConstRosenbrock', but evaluated by workers connected through TCP
+struct DistributedConstRosenbrock : ConstRosenbrock
+{
+	DistributedConstRosenbrock ()
+	{
+		numInequalities = 1;
+	}
+
+	void evaluateBatch (mde::Batch& batch)
+	{
+		pool->evaluate(batch);
+	}
+
+	/// Main loop of a worker
+	static int serve (int port)
+	{
+		return mde::serveTcp("127.0.0.1", port, 2, 1, 0, [](const double* x, int, double* inequalities, double*)
+		{
+			inequalities[0] = std::pow(x[0] - 1.0/3, 2) + std::pow(x[1] - 1.0/3, 2) - std::pow(1.0/3, 2);
+
+			return 100.0 * std::pow(x[1] - x[0] * x[0], 2) + std::pow(1.0 - x[0], 2);
+		});
+	}
+
+	std::shared_ptr<mde::DistributedPool> pool = std::make_shared<mde::DistributedPool>(2, 1, 0, mde::Network{ 0, "127.0.0.1", "" });
+};
+
+
+
+/// Same as 'Rosenbrock', but stopping the sum as soon as it reaches the cutoff
+struct CutoffRosenbrock : Rosenbrock
+{
+	double operator () (const Vector& x, double cutoff)
+	{
+		double r = 0.0;
+
+		for(int i = 0; i < int(x.size()) - 1; ++i)
+		{
+			r += 100.0 * std::pow(x[i] * x[i] - x[i+1], 2) + std::pow(x[i] - 1.0, 2);
+
+			if(r >= cutoff && i < int(x.size()) - 2)
+			{
+				(*aborted)++;
+				return r;
+			}
+		}
+
+		return r;
+	}
+
+	/// Shared by the copies of the function
+	std::shared_ptr<std::atomic<long>> aborted = std::make_shared<std::atomic<long>>(0);
+};
+
+
+/// Same as 'ConstRosenbrock', but returning the cutoff itself when the fitness reaches it
+struct CutoffConstRosenbrock : ConstRosenbrock
+{
+	double operator () (const Vector& x, double cutoff)
+	{
+		return std::min(ConstRosenbrock::operator()(x), cutoff);
+	}
+};
+
+
+/// Weighted sphere, with the incremental evaluation of the changed variables
+struct DeltaSphere : mde::Function<>
+{
+	DeltaSphere (int M = 20) : mde::Function<>(M, -5.0, 5.0, 1e-10) {}
+
+
+	double term (double x, int j) const
+	{
+		return (j + 1) * (x - 1.0) * (x - 1.0);
+	}
+
+	double operator () (const Vector& x)
+	{
+		(*full)++;
+
+		double r = 0.0;
+
+		for(int j = 0; j < int(x.size()); ++j)
+			r += term(x[j], j);
+
+		return r;
+	}
+
+	double evaluateDelta (const Vector& x, const double* parent, double parentFitness, const int* changed, int numChanged)
+	{
+		(*delta)++;
+
+		for(int c = 0; c < numChanged; ++c)
+			parentFitness += term(x[changed[c]], changed[c]) - term(parent[changed[c]], changed[c]);
+
+		return parentFitness;
+	}
+
+	/// Shared by the copies of the function
+	std::shared_ptr<std::atomic<long>> full = std::make_shared<std::atomic<long>>(0);
+	std::shared_ptr<std::atomic<long>> delta = std::make_shared<std::atomic<long>>(0);
+};
+
+
+/// Each inequality depends on two neighbor variables, and the last one depends on all of them
+struct SparseConstrained : mde::Function<>
+{
+	SparseConstrained (int M = 20) : mde::Function<>(M, -5.0, 5.0)
+	{
+		numInequalities = M;
+
+		for(int j = 0; j < M - 1; ++j)
+			constraintVariables.push_back({ j, j + 1 });
+	}
+
+
+	double operator () (const Vector& x)
+	{
+		double r = 0.0;
+
+		for(int j = 0; j < int(x.size()); ++j)
+			r += (j + 1) * (x[j] - 1.0) * (x[j] - 1.0);
+
+		return r;
+	}
+
+	double constraint (const Vector& x, int c)
+	{
+		(*calls)++;
+
+		if(c < int(x.size()) - 1)
+			return x[c] + x[c+1] - 1.5;
+
+		return std::accumulate(x.begin(), x.end(), 0.0) - 100.0;
+	}
+
+	/// Shared by the copies of the function
+	std::shared_ptr<std::atomic<long>> calls = std::make_shared<std::atomic<long>>(0);
+};
+
+
+/// Same as 'ConstRosenbrock', counting the calls to the objective
+struct CountingConstRosenbrock : ConstRosenbrock
+{
+	double operator () (const Vector& x)
+	{
+		(*calls)++;
+
+		return ConstRosenbrock::operator()(x);
+	}
+
+	/// Shared by the copies of the function
+	std::shared_ptr<std::atomic<long>> calls = std::make_shared<std::atomic<long>>(0);
+};
+
+
+/// Same as 'ConstRosenbrock', with a slow objective, so other commits reach a row while its parent is completed
+struct SlowConstRosenbrock : ConstRosenbrock
+{
+	double operator () (const Vector& x)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+		return ConstRosenbrock::operator()(x);
+	}
+};
+
+
+/// Same as 'ConstRosenbrock', evaluating the objective on another thread and counting the evaluations running at once
+struct AsyncConstRosenbrock : ConstRosenbrock
+{
+	std::future<double> evaluateAsync (const Vector& x)
+	{
+		if(--(*throwAfter) == 0)
+			return std::async(std::launch::deferred, []() -> double { throw std::runtime_error("Evaluation failed"); });
+
+		return std::async(std::launch::async, [this, &x]
+		{
+			long now = ++(*running);
+
+			for(long most = *largest; now > most && !largest->compare_exchange_weak(most, now); ) {}
+
+			double fitness = ConstRosenbrock::operator()(x);    /// 'x' is still alive here
+
+			(*running)--;
+
+			return fitness;
+		});
+	}
+
+	/// Shared by the copies of the function
+	std::shared_ptr<std::atomic<long>> running = std::make_shared<std::atomic<long>>(0);
+	std::shared_ptr<std::atomic<long>> largest = std::make_shared<std::atomic<long>>(0);
+	std::shared_ptr<std::atomic<long>> throwAfter = std::make_shared<std::atomic<long>>(-1);
+};
+
+
+/// Same as 'ConstRosenbrock', but computing the objective and the constraint in a single call
+struct FusedConstRosenbrock : mde::Function<>
+{
+	FusedConstRosenbrock ()
+	{
+		numInequalities = 2;
+	}
+
+	double evaluate (const Vector& x, double* inequalities, double*)
+	{
+		(*calls)++;
+
+		inequalities[0] = std::pow(x[0] - 1.0/3, 2) + std::pow(x[1] - 1.0/3, 2) - std::pow(1.0/3, 2);
+		inequalities[1] = -1.0;
+
+		return 100.0 * std::pow(x[1] - x[0] * x[0], 2) + std::pow(1.0 - x[0], 2);
+	}
+
+	/// Shared by the copies of the function
+	std::shared_ptr<std::atomic<int>> calls = std::make_shared<std::atomic<int>>(0);
+
+	int N = 2;
+};
+
+
 TEST_FUNCTION(F1)
 TEST_FUNCTION(F2)
 TEST_FUNCTION(F3)
@@ -199,6 +500,28 @@ TEST_FUNCTION(F24)
 
 
 
+TEST_F(MDETest, ParallelCEC2006)
+{
+	params.threads = 4;
+
+	auto run = [&](auto func)
+	{
+		MDE<decltype(func)> mde(params);
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_GT(mde.evaluations(), 0);
+		EXPECT_EQ(mde.evaluations(), long(mde.function.FEs));
+	};
+
+	run(F1());
+	run(F5());
+	run(F22());
+}
+
+
 TEST_F(MDETest, Ackley)
 {
 	params.bndHandle = "clip";
@@ -235,6 +558,1720 @@ TEST_F(MDETest, ConstRosenbrock)
 }
 
 
+TEST_F(MDETest, CompileTimeBounds)
+{
+	MDE<Ackley, mde::bounds::Clip> clip(params);
+	MDE<Rosenbrock, mde::bounds::Conservate> conservate(params);
+	MDE<ConstRosenbrock, mde::bounds::Reinitialize> reinitialize(params);
+
+	SCOPED_TRACE("CompileTimeBounds");
+
+	check(clip(), clip.function.lowerBounds, clip.function.upperBounds);
+	check(conservate(), conservate.function.lowerBounds, conservate.function.upperBounds);
+	check(reinitialize(), reinitialize.function.lowerBounds, reinitialize.function.upperBounds);
+}
+
+
+TEST_F(MDETest, BoundsHandlers)
+{
+	for(std::string handle : { "conservateall", "reflection", "midpoint" })
+	{
+		params.bndHandle = handle;
+
+		MDE<Ackley> mde(params);
+
+		SCOPED_TRACE(handle);
+
+		check(mde(), mde.function.lowerBounds, mde.function.upperBounds);
+	}
+}
+
+
+TEST_F(MDETest, FusedEvaluation)
+{
+	params.threads = 4;
+
+	MDE<FusedConstRosenbrock> mde(params);
+
+	SCOPED_TRACE("FusedEvaluation");
+
+	auto best = mde();
+
+	check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+	EXPECT_TRUE(best.feasible());
+	EXPECT_GT(*mde.function.calls, 0);
+}
+
+
+TEST_F(MDETest, LazyEvaluation)
+{
+	params.lazy = true;
+
+	for(int threads : { 1, 4 })
+	{
+		params.threads = threads;
+
+		MDE<CountingConstRosenbrock> mde(params);
+
+		SCOPED_TRACE("LazyEvaluation");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_TRUE(best.feasible());
+		EXPECT_GT(mde.skippedObjectives(), 0);
+		EXPECT_EQ(*mde.function.calls, mde.evaluations() - mde.skippedObjectives());
+	}
+}
+
+
+TEST_F(MDETest, EarlyAbort)
+{
+	static_assert(mde::SetValues<CutoffRosenbrock>::hasCutoff(), "Cutoff not detected");
+	static_assert(!mde::SetValues<Rosenbrock>::hasCutoff(), "Cutoff wrongly detected");
+
+	params.bndHandle = "reinitialize";
+
+	for(int threads : { 1, 4 })
+	{
+		params.threads = threads;
+
+		MDE<CutoffRosenbrock> mde(params);
+
+		SCOPED_TRACE("EarlyAbort");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		/// The fitness kept is exact, even if many evaluations were aborted
+		EXPECT_GT(*mde.function.aborted, 0);
+		EXPECT_DOUBLE_EQ(best.fitness, mde.function.Rosenbrock::operator()(best));
+
+		for(int i = 0; i < params.popSize; ++i)
+			EXPECT_DOUBLE_EQ(mde.population.fitness[i], mde.function.Rosenbrock::operator()(mde.population.vector<CutoffRosenbrock::Vector>(i)));
+	}
+}
+
+
+TEST_F(MDETest, DeltaEvaluation)
+{
+	static_assert(mde::SetValues<DeltaSphere>::hasDelta(), "Delta not detected");
+	static_assert(!mde::SetValues<Rosenbrock>::hasDelta(), "Delta wrongly detected");
+
+	params.Cr = 0.2;
+	params.bndHandle = "clip";
+
+	for(int threads : { 1, 4 })
+	{
+		params.threads = threads;
+
+		MDE<DeltaSphere> mde(params);
+
+		SCOPED_TRACE("DeltaEvaluation");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_GT(*mde.function.delta, *mde.function.full);
+		EXPECT_EQ(*mde.function.delta + *mde.function.full, mde.evaluations());
+
+		/// The incremental values only differ from the complete ones by rounding errors
+		EXPECT_NEAR(best.fitness, mde.function.DeltaSphere::operator()(best), 1e-8);
+
+		for(int i = 0; i < params.popSize; ++i)
+			EXPECT_NEAR(mde.population.fitness[i], mde.function.DeltaSphere::operator()(mde.population.vector<DeltaSphere::Vector>(i)), 1e-8);
+	}
+}
+
+
+TEST_F(MDETest, SparseConstraints)
+{
+	static_assert(mde::SetValues<SparseConstrained>::hasSparseConstraints(), "Sparse constraints not detected");
+	static_assert(!mde::SetValues<ConstRosenbrock>::hasSparseConstraints(), "Sparse constraints wrongly detected");
+
+	params.Cr = 0.2;
+	params.maxIter = 1000;
+
+	for(bool lazy : { false, true })
+	{
+		params.lazy = lazy;
+
+		for(int threads : { 1, 4 })
+		{
+			params.threads = threads;
+
+			MDE<SparseConstrained> mde(params);
+
+			SCOPED_TRACE("SparseConstraints");
+
+			auto best = mde();
+
+			check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+			EXPECT_TRUE(best.feasible());
+			EXPECT_LT(*mde.function.calls, mde.evaluations() * mde.function.numInequalities / 2);
+
+			/// The values kept for the population are the same as the ones evaluated from scratch
+			mde::Workspace workspace;
+
+			for(int i = 0; i < params.popSize; ++i)
+			{
+				auto x = mde.population.vector<SparseConstrained::Vector>(i);
+
+				EXPECT_DOUBLE_EQ(mde.population.violation[i], mde.function.setViolation(x, workspace));
+
+				for(int c = 0; c < mde.function.numInequalities; ++c)
+					EXPECT_DOUBLE_EQ(mde.population.constraintValues(i)[c], workspace.constraints[c]);
+			}
+		}
+	}
+}
+
+
+TEST_F(MDETest, EvaluationCache)
+{
+	params.Cr = 0.2;
+	params.maxIter = 200;
+	params.cacheMemory = 1 << 16;
+
+	CountingConstRosenbrock function;
+
+	function.lowerBounds = { 0.0, 0.0 };
+	function.upperBounds = { 0.5, 0.5 };
+
+	for(int threads : { 1, 4 })
+	{
+		params.threads = threads;
+
+		MDE<CountingConstRosenbrock> mde(params, function);
+
+		*mde.function.calls = 0;
+
+		SCOPED_TRACE("EvaluationCache");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		/// Every child is either evaluated or taken from the cache
+		EXPECT_GT(mde.cacheHits(), 0);
+		EXPECT_EQ(mde.cacheHits() + mde.cacheMisses(), long(params.maxIter) * params.popSize * params.children);
+		EXPECT_EQ(mde.evaluations(), params.popSize + mde.cacheMisses());
+		EXPECT_EQ(*mde.function.calls, mde.cacheMisses());
+	}
+}
+
+
+TEST_F(MDETest, PersistentStore)
+{
+	const std::string path = ::testing::TempDir() + "mde_store_run.bin";
+
+	std::remove(path.c_str());
+
+	params.maxIter = 200;
+	params.storePath = path;
+	params.storeProblem = "ConstRosenbrock";
+
+	for(int threads : { 1, 4 })
+	{
+		params.threads = threads;
+
+		MDE<CountingConstRosenbrock> mde(params);
+
+		SCOPED_TRACE("PersistentStore");
+
+		check(mde(), mde.function.lowerBounds, mde.function.upperBounds);
+
+		/// Another run (here, another store) finds the values of the population
+		mde::help::PersistentStore store;
+
+		store.open(path, params.storeProblem, 2, 2, 0);
+
+		for(int i = 0; i < params.popSize; ++i)
+		{
+			double key[2], values[2];
+
+			ASSERT_TRUE(store.find(key, mde::help::candidateKey(mde.population[i], key, 2), values));
+
+			EXPECT_EQ(values[0], mde.population.fitness[i]);
+			EXPECT_EQ(values[1], mde.population.violation[i]);
+		}
+	}
+
+	/// Without an identity, the problem would read the records of any other one of the same sizes
+	params.storeProblem = "";
+
+	EXPECT_THROW(MDE<CountingConstRosenbrock>{ params }, std::runtime_error);
+
+	std::remove(path.c_str());
+}
+
+
+TEST_F(MDETest, Asynchronous)
+{
+	params.threads = 4;
+	params.asynchronous = true;
+
+	{
+		MDE<ConstRosenbrock> mde(params);
+
+		SCOPED_TRACE("AsynchronousConstRosenbrock");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_TRUE(best.feasible());
+		EXPECT_EQ(mde.evaluations(), params.popSize + long(params.maxIter) * params.popSize * params.children);
+	}
+
+	{
+		params.bndHandle = "reinitialize";
+
+		MDE<CutoffRosenbrock> mde(params);
+
+		SCOPED_TRACE("AsynchronousEarlyAbort");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		/// Even with the parents changing during a step, no aborted value is kept
+		EXPECT_DOUBLE_EQ(best.fitness, mde.function.Rosenbrock::operator()(best));
+
+		for(int i = 0; i < params.popSize; ++i)
+			EXPECT_DOUBLE_EQ(mde.population.fitness[i], mde.function.Rosenbrock::operator()(mde.population.vector<CutoffRosenbrock::Vector>(i)));
+	}
+
+	{
+		params.Srmin = 0.01;    /// Steps comparing only the fitness may still put infeasible rows in place of feasible ones
+
+		MDE<CutoffConstRosenbrock> mde(params);
+
+		SCOPED_TRACE("AsynchronousConstrainedEarlyAbort");
+
+		auto best = mde();
+
+		EXPECT_DOUBLE_EQ(best.fitness, mde.function.ConstRosenbrock::operator()(best));
+
+		for(int i = 0; i < params.popSize; ++i)
+			EXPECT_DOUBLE_EQ(mde.population.fitness[i], mde.function.ConstRosenbrock::operator()(mde.population.vector<CutoffConstRosenbrock::Vector>(i)));
+
+		params.Srmin = 0.025;
+	}
+
+	{
+		params.lazy = true;
+		params.Cr = 0.2;
+		params.maxIter = 1000;
+
+		MDE<SparseConstrained> mde(params);
+
+		SCOPED_TRACE("AsynchronousSparseConstraints");
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_TRUE(best.feasible());
+
+		mde::Workspace workspace;
+
+		for(int i = 0; i < params.popSize; ++i)
+		{
+			auto x = mde.population.vector<SparseConstrained::Vector>(i);
+
+			EXPECT_DOUBLE_EQ(mde.population.violation[i], mde.function.setViolation(x, workspace));
+		}
+	}
+}
+
+
+TEST_F(MDETest, AsynchronousLazyCommits)
+{
+	/// Many workers on few rows, half of the steps comparing only the fitness, so the parents skipped by the lazy
+	/// evaluation are often completed while other workers commit to the same row
+	params.threads = 8;
+	params.asynchronous = true;
+	params.lazy = true;
+	params.popSize = 4;
+	params.children = 2;
+	params.maxIter = 200;
+	params.Srmax = params.Srmin = 0.5;
+
+	MDE<SlowConstRosenbrock> mde(params);
+
+	mde();
+
+	EXPECT_GT(mde.skippedObjectives(), 0);
+
+	mde::Workspace workspace;
+
+	for(int i = 0; i < params.popSize; ++i)
+	{
+		auto x = mde.population.vector<SlowConstRosenbrock::Vector>(i);
+
+		EXPECT_DOUBLE_EQ(mde.population.violation[i], mde.function.setViolation(x, workspace));
+
+		if(!std::isnan(mde.population.fitness[i]))    /// A completed value belongs to the row it was kept in
+		{
+			EXPECT_DOUBLE_EQ(mde.population.fitness[i], mde.function.ConstRosenbrock::operator()(x));
+		}
+	}
+}
+
+
+TEST_F(MDETest, AsyncEvaluation)
+{
+	params.maxIter = 50;
+	params.maxInFlight = 8;
+
+	{
+		MDE<AsyncConstRosenbrock> mde(params);
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_TRUE(best.feasible());
+		EXPECT_EQ(mde.evaluations(), params.popSize + long(params.maxIter) * params.popSize * params.children);
+		EXPECT_LE(mde.function.largest->load(), params.maxInFlight);
+		EXPECT_EQ(mde.function.running->load(), 0);
+
+		/// Every fitness is exact, whatever the order the evaluations complete
+		for(int i = 0; i < params.popSize; ++i)
+			EXPECT_DOUBLE_EQ(mde.population.fitness[i], mde.function.ConstRosenbrock::operator()(mde.population.vector<ConstRosenbrock::Vector>(i)));
+	}
+
+	{
+		params.threads = 4;
+
+		AsyncConstRosenbrock function;
+
+		*function.throwAfter = params.popSize + 20;
+
+		MDE<AsyncConstRosenbrock> mde(params, function);
+
+		/// The failure is rethrown only after the other evaluations in flight are done
+		EXPECT_THROW(mde(), std::runtime_error);
+		EXPECT_EQ(mde.function.running->load(), 0);
+	}
+}
+
+
+TEST_F(MDETest, Islands)
+{
+	params.maxIter = 300;
+
+	std::vector<Parameters> islandParams(3, params);
+
+	islandParams[1].bndHandle = "reflection";
+	islandParams[2].Cr = 0.5;
+	islandParams[2].popSize = 20;
+
+	for(auto topology : { Migration::Ring, Migration::Random, Migration::Full })
+	{
+		SCOPED_TRACE(topology);
+
+		Migration migration;
+
+		migration.topology = topology;
+		migration.interval = 10;
+
+		Islands<ConstRosenbrock> islands(islandParams, migration);
+
+		auto best = islands();
+
+		check(best, islands.island(0).function.lowerBounds, islands.island(0).function.upperBounds);
+
+		EXPECT_TRUE(best.feasible());
+
+		long emigrants = 0, immigrants = 0;
+
+		for(int k = 0; k < islands.size(); ++k)
+		{
+			const IslandStatistics& s = islands.statistics()[k];
+
+			EXPECT_EQ(s.generations, params.maxIter);
+			EXPECT_EQ(s.evaluations, islandParams[k].popSize + long(s.generations) * islandParams[k].popSize * params.children);
+			EXPECT_GT(s.emigrants, 0);
+			EXPECT_LE(s.accepted, s.immigrants);
+
+			/// The global best is the best of the islands
+			EXPECT_FALSE(mde::help::better(s.fitness, s.violation, best.fitness, best.violation));
+
+			emigrants += s.emigrants;
+			immigrants += s.immigrants;
+		}
+
+		/// The last ones sent may not have been taken yet
+		EXPECT_LE(immigrants, emigrants);
+		EXPECT_GT(immigrants, 0);
+	}
+}
+
+
+TEST_F(MDETest, ProcessIslands)
+{
+	params.maxIter = 200;
+
+	Migration migration;
+
+	migration.topology = Migration::Full;
+	migration.interval = 10;
+
+	const std::string name = "/mde-test-islands-" + std::to_string(::getpid());
+	const int numProcesses = 3;
+
+	/// The island of this process opens the segment first, so it is still there when the others finish
+	ProcessIsland<ConstRosenbrock> island(name, 0, numProcesses, params, migration);
+
+	{
+		mde::help::IslandSegment other;
+
+		EXPECT_THROW(other.open(name, 1, numProcesses, 3, 0, 8), std::runtime_error);
+	}
+
+	std::vector<pid_t> children;
+
+	for(int rank = 1; rank < numProcesses; ++rank)
+	{
+		pid_t pid = ::fork();
+
+		if(pid == 0)
+		{
+			int code = 1;
+
+			try
+			{
+				ProcessIsland<ConstRosenbrock> child(name, rank, numProcesses, params, migration);
+
+				auto best = child();
+
+				code = best.feasible() && child.statistics().emigrants > 0 ? 0 : 2;
+			}
+
+			catch(...) {}
+
+			::_exit(code);
+		}
+
+		children.push_back(pid);
+	}
+
+	for(pid_t pid : children)
+	{
+		int status = 0;
+
+		::waitpid(pid, &status, 0);
+
+		EXPECT_TRUE(WIFEXITED(status));
+		EXPECT_EQ(WEXITSTATUS(status), 0);
+	}
+
+
+	/// The other islands are done, so their individuals are waiting in the queues
+	auto best = island();
+
+	check(best, island.island.function.lowerBounds, island.island.function.upperBounds);
+
+	EXPECT_TRUE(best.feasible());
+	EXPECT_EQ(island.statistics().generations, params.maxIter);
+	EXPECT_GT(island.statistics().immigrants, 0);
+	EXPECT_FALSE(mde::help::better(island.statistics().fitness, island.statistics().violation, best.fitness, best.violation));
+}
+
+
+TEST_F(MDETest, SubprocessEvaluation)
+{
+	params.maxIter = 100;
+
+	MDE<SubprocessConstRosenbrock> mde(params);
+
+	auto best = mde();
+
+	check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+	EXPECT_TRUE(best.feasible());
+	EXPECT_EQ(mde.function.pool->restarts(), 0);
+}
+
+
+TEST(SubprocessTest, RestartsFailedWorkers)
+{
+	const int count = 20, N = 3;
+
+	/// Each worker crashes at its 7th candidate, and hangs at any candidate with a negative first variable
+	auto serve = []
+	{
+		int evaluated = 0;
+
+		return mde::serveSubprocess(N, 1, 1, [&](const double* x, int N, double* inequalities, double* equalities)
+		{
+			if(++evaluated == 7)
+				::_exit(3);
+
+			if(x[0] < 0.0)
+				::pause();
+
+			inequalities[0] = x[0] - x[1];
+			equalities[0] = x[N-1];
+
+			return x[0] + x[1] + x[2];
+		});
+	};
+
+	mde::SubprocessPool pool(serve, 2, 0.2);
+
+	std::vector<double> x(count * N), fitness(count), inequalities(count), equalities(count);
+
+	for(int k = 0; k < count; ++k)
+		for(int j = 0; j < N; ++j)
+			x[k * N + j] = k * (j + 1);
+
+	mde::Batch batch{ x.data(), count, N, N, fitness.data(), inequalities.data(), equalities.data(), 1, 1 };
+
+	pool.evaluate(batch);
+
+	for(int k = 0; k < count; ++k)
+	{
+		EXPECT_EQ(fitness[k], 6 * k);
+		EXPECT_EQ(inequalities[k], -k);
+		EXPECT_EQ(equalities[k], 3 * k);
+	}
+
+	/// Both chunks crashed
+	EXPECT_GE(pool.restarts(), 2);
+	EXPECT_EQ(pool.failures(), 0);
+
+
+	/// The hanging candidate fails twice alone, and the others are still evaluated
+	x[5 * N] = -1.0;
+
+	pool.evaluate(batch);
+
+	EXPECT_EQ(pool.failures(), 1);
+	EXPECT_TRUE(std::isinf(fitness[5]) && std::isinf(inequalities[5]) && std::isinf(equalities[5]));
+
+	for(int k = 0; k < count; ++k)
+		EXPECT_EQ(fitness[k], k == 5 ? fitness[5] : 6 * k);
+}
+
+
+TEST(SubprocessTest, RejectsRequestsOfOtherSizes)
+{
+	int evaluated = 0;
+
+	auto f = [&](const double*, int, double*, double*)
+	{
+		evaluated++;
+		return 0.0;
+	};
+
+	/// Answers a single request with the given header, for a worker of 3 variables, 1 inequality and 1 equality
+	auto serve = [&](std::uint32_t count, std::uint32_t N, std::uint32_t numInequalities, std::uint32_t numEqualities)
+	{
+		int fds[2];
+
+		EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+		const std::uint32_t header[4] = { count, N, numInequalities, numEqualities };
+		const std::vector<double> x(std::size_t(std::min(count, 4u)) * N);
+
+		EXPECT_EQ(::write(fds[0], header, sizeof(header)), ssize_t(sizeof(header)));
+		EXPECT_EQ(::write(fds[0], x.data(), x.size() * sizeof(double)), ssize_t(x.size() * sizeof(double)));
+
+		::shutdown(fds[0], SHUT_WR);
+
+		const int code = mde::help::serveRequests(fds[1], fds[1], f, 3, 1, 1);
+
+		::close(fds[0]);
+		::close(fds[1]);
+
+		return code;
+	};
+
+	EXPECT_EQ(serve(4, 3, 1, 1), 0);
+	EXPECT_EQ(evaluated, 4);
+
+	EXPECT_EQ(serve(4, 2, 1, 1), 1);
+	EXPECT_EQ(serve(4, 3, 0, 1), 1);
+	EXPECT_EQ(serve(4, 3, 1, 2), 1);
+	EXPECT_EQ(serve(0, 3, 1, 1), 1);
+	EXPECT_EQ(serve(std::uint32_t(-1), 3, 1, 1), 1);    /// Over 1 GiB
+
+	EXPECT_EQ(evaluated, 4);
+}
+
+
+TEST_F(MDETest, DistributedEvaluation)
+{
+	params.maxIter = 100;
+
+	DistributedConstRosenbrock function;
+
+	std::vector<std::thread> workers;
+
+	for(int w = 0; w < 2; ++w)
+		workers.emplace_back(DistributedConstRosenbrock::serve, function.pool->port());
+
+	{
+		MDE<DistributedConstRosenbrock> mde(params, function);
+
+		auto best = mde();
+
+		check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+		EXPECT_TRUE(best.feasible());
+		EXPECT_EQ(function.pool->joined(), 2);
+		EXPECT_EQ(function.pool->dropped(), 0);
+	}
+
+	function.pool.reset();    /// Closes the connections, so the workers return
+
+	for(auto& t : workers)
+		t.join();
+}
+
+
+TEST(DistributedTest, RequeuesLostChunks)
+{
+	const int count = 40, N = 3;
+
+	std::unique_ptr<mde::DistributedPool> pool(new mde::DistributedPool(N, 1, 1, mde::Network{ 0, "127.0.0.1", "" }, 0.0, 4));
+
+	/// The worker 0 leaves (by throwing) at its 5th candidate, after answering its first chunk
+	auto serve = [&pool](int w)
+	{
+		int evaluated = 0;
+
+		try
+		{
+			mde::serveTcp("127.0.0.1", pool->port(), N, 1, 1, [&](const double* x, int N, double* inequalities, double* equalities)
+			{
+				if(w == 0 && ++evaluated == 5)
+					throw std::runtime_error("Leaving");
+
+				inequalities[0] = x[0] - x[1];
+				equalities[0] = x[N-1];
+
+				return x[0] + x[1] + x[2];
+			});
+		}
+
+		catch(const std::runtime_error&) {}
+	};
+
+	std::vector<std::thread> workers;
+
+	for(int w = 0; w < 3; ++w)
+		workers.emplace_back(serve, w);
+
+	ASSERT_TRUE(pool->waitWorkers(3, 10.0));
+
+
+	std::vector<double> x(count * N), fitness(count), inequalities(count), equalities(count);
+
+	for(int k = 0; k < count; ++k)
+		for(int j = 0; j < N; ++j)
+			x[k * N + j] = k * (j + 1);
+
+	mde::Batch batch{ x.data(), count, N, N, fitness.data(), inequalities.data(), equalities.data(), 1, 1 };
+
+	pool->evaluate(batch);
+
+	for(int k = 0; k < count; ++k)
+	{
+		EXPECT_EQ(fitness[k], 6 * k);
+		EXPECT_EQ(inequalities[k], -k);
+		EXPECT_EQ(equalities[k], 3 * k);
+	}
+
+	EXPECT_EQ(pool->dropped(), 1);
+	EXPECT_GE(pool->requeued(), 1);
+	EXPECT_EQ(pool->failures(), 0);
+	EXPECT_EQ(pool->size(), 2);
+
+
+	/// A worker joining between two blocks takes part in the next one
+	workers.emplace_back(serve, 3);
+
+	ASSERT_TRUE(pool->waitWorkers(3, 10.0));
+
+	std::fill(fitness.begin(), fitness.end(), 0.0);
+
+	pool->evaluate(batch);
+
+	for(int k = 0; k < count; ++k)
+		EXPECT_EQ(fitness[k], 6 * k);
+
+	EXPECT_EQ(pool->joined(), 4);
+
+
+	pool.reset();
+
+	for(auto& t : workers)
+		t.join();
+}
+
+
+TEST(DistributedTest, RejectsWorkersWithoutTokenOrSizes)
+{
+	const int count = 10, N = 3;
+
+	EXPECT_THROW(mde::DistributedPool(N, 1, 1, mde::Network{ 0, "not an address", "" }), std::runtime_error);
+
+	std::unique_ptr<mde::DistributedPool> pool(new mde::DistributedPool(N, 1, 1, mde::Network{ 0, "127.0.0.1", "secret" }));
+
+	/// The worker 0 has the token, the worker 1 has another token and the worker 2 has other sizes
+	auto serve = [&pool](int w)
+	{
+		return mde::serveTcp("127.0.0.1", pool->port(), N, w == 2 ? 0 : 1, 1, [](const double* x, int, double* inequalities, double* equalities)
+		{
+			inequalities[0] = x[0] - x[1];
+			equalities[0] = x[2];
+
+			return x[0] + x[1] + x[2];
+		}, w == 1 ? "secreT" : "secret");
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<int> codes(3, -1);
+
+	for(int w = 0; w < 3; ++w)
+		workers.emplace_back([&, w]{ codes[w] = serve(w); });
+
+	EXPECT_FALSE(pool->waitWorkers(2, 1.0));    /// Only the worker 0 is accepted
+
+	EXPECT_EQ(pool->size(), 1);
+	EXPECT_EQ(pool->joined(), 1);
+	EXPECT_EQ(pool->rejected(), 2);
+	EXPECT_EQ(pool->dropped(), 0);
+
+	workers[1].join();
+	workers[2].join();
+
+	EXPECT_EQ(codes[1], 0);    /// The master closed the connection
+	EXPECT_EQ(codes[2], 1);    /// The hello has other sizes
+
+
+	std::vector<double> x(count * N), fitness(count), inequalities(count), equalities(count);
+
+	for(int k = 0; k < count; ++k)
+		for(int j = 0; j < N; ++j)
+			x[k * N + j] = k * (j + 1);
+
+	mde::Batch batch{ x.data(), count, N, N, fitness.data(), inequalities.data(), equalities.data(), 1, 1 };
+
+	pool->evaluate(batch);
+
+	for(int k = 0; k < count; ++k)
+		EXPECT_EQ(fitness[k], 6 * k);
+
+	batch.numEqualities = 0;
+
+	EXPECT_THROW(pool->evaluate(batch), std::runtime_error);
+
+	pool.reset();
+
+	workers[0].join();
+
+	EXPECT_EQ(codes[0], 0);
+}
+
+
+TEST(IslandSegmentTest, RestartsAfterCrashedRun)
+{
+	const std::string name = "/mde-test-segment-" + std::to_string(::getpid());
+
+	/// A process that stops the run, offers a best individual and dies without closing the segment
+	pid_t pid = ::fork();
+
+	if(pid == 0)
+	{
+		mde::help::IslandSegment segment;
+
+		segment.open(name, 1, 2, 2, 0, 4);
+
+		double x[2] = { 1.0, 2.0 };
+
+		segment.offerBest(x, 3.0, 0.0);
+		segment.stop();
+
+		::_exit(0);
+	}
+
+	int status = 0;
+
+	::waitpid(pid, &status, 0);
+
+	ASSERT_TRUE(WIFEXITED(status));
+
+
+	/// Nobody of that run is alive, so a new one starts, even with other sizes
+	mde::help::IslandSegment segment;
+
+	segment.open(name, 0, 2, 3, 0, 4);
+
+	double x[3], fitness, violation;
+
+	EXPECT_FALSE(segment.stopped());
+	EXPECT_FALSE(segment.best(x, fitness, violation));
+
+	/// This process is alive, so the others join its run, with the same sizes
+	{
+		mde::help::IslandSegment other;
+
+		EXPECT_THROW(other.open(name, 1, 2, 2, 0, 4), std::runtime_error);
+
+		other.open(name, 1, 2, 3, 0, 4);
+		other.stop();
+	}
+
+	EXPECT_TRUE(segment.stopped());
+
+	segment.close(true);
+	::shm_unlink(name.c_str());
+}
+
+
+TEST_F(MDETest, ParallelAckley)
+{
+	params.bndHandle = "clip";
+	params.threads = 4;
+
+	MDE<Ackley> mde(params);
+
+	SCOPED_TRACE("ParallelAckley");
+
+	check(mde(), mde.function.lowerBounds, mde.function.upperBounds);
+}
+
+
+TEST_F(MDETest, ParallelConstRosenbrock)
+{
+	params.threads = 4;
+
+	MDE<ConstRosenbrock> mde(params);
+
+	SCOPED_TRACE("ParallelConstRosenbrock");
+
+	auto best = mde();
+
+	check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+	EXPECT_TRUE(best.feasible());
+}
+
+
+TEST_F(MDETest, BatchEvaluation)
+{
+	params.maxIter = 100;
+
+	MDE<BatchConstRosenbrock> mde(params);
+
+	auto best = mde();
+
+	check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+	EXPECT_GT(mde.function.calls, 0);
+	EXPECT_EQ(mde.function.largest, params.popSize * params.children);
+}
+
+
+TEST_F(MDETest, ParallelBatchEvaluation)
+{
+	params.threads = 4;
+
+	MDE<BatchConstRosenbrock> mde(params);
+
+	auto best = mde();
+
+	check(best, mde.function.lowerBounds, mde.function.upperBounds);
+
+	EXPECT_TRUE(best.feasible());
+}
+
+
+/// Number of heap allocations of a full run of 'MDE<Func>' with 'params', not counting the construction
+template <class Func>
+long runAllocations (const Parameters& params)
+{
+	MDE<Func> mde(params);
+
+	allocations = 0;
+	countAllocations = true;
+
+	mde();
+
+	countAllocations = false;
+
+	return allocations;
+}
+
+
+TEST_F(MDETest, NoAllocationsPerGeneration)
+{
+	params.bndHandle = "clip";
+
+	for(int threads : { 1, 4 })
+	{
+		params.threads = threads;
+
+		params.maxIter = 2;
+		long few = runAllocations<Ackley>(params);
+
+		params.maxIter = 50;
+		long many = runAllocations<Ackley>(params);
+
+		EXPECT_EQ(few, many) << "threads = " << threads;
+
+		params.maxIter = 2;
+		few = runAllocations<BatchConstRosenbrock>(params);
+
+		params.maxIter = 50;
+		many = runAllocations<BatchConstRosenbrock>(params);
+
+		EXPECT_EQ(few, many) << "batch, threads = " << threads;
+	}
+}
+
+
+TEST(SetValuesTest, BatchMatchesSingleEvaluation)
+{
+	SetValues<BatchConstRosenbrock> batchFunc;
+	SetValues<ConstRosenbrock> func;
+
+	std::vector<double> x = { 0.1, 0.3,   0.5, 0.8,   0.0, 0.2 };
+	std::vector<double> fitness(3), violation(3), ineqs(3);
+
+	Batch batch{ x.data(), 3, 2, 2, fitness.data(), ineqs.data(), nullptr, 1, 0 };
+
+	batchFunc(batch, violation.data());
+
+	std::vector<double> fallbackFitness(3), fallbackViolation(3);
+
+	Batch fallback{ x.data(), 3, 2, 2, fallbackFitness.data(), nullptr, nullptr, 0, 0 };
+
+	func(fallback, fallbackViolation.data());
+
+	for(int k = 0; k < 3; ++k)
+	{
+		ConstRosenbrock::Vector v{ x[2*k], x[2*k+1] };
+
+		func(v);
+
+		EXPECT_DOUBLE_EQ(fitness[k], v.fitness);
+		EXPECT_DOUBLE_EQ(violation[k], v.violation);
+		EXPECT_DOUBLE_EQ(fallbackFitness[k], v.fitness);
+		EXPECT_DOUBLE_EQ(fallbackViolation[k], v.violation);
+	}
+
+	EXPECT_TRUE(SetValues<BatchConstRosenbrock>::hasBatch());
+	EXPECT_FALSE(SetValues<ConstRosenbrock>::hasBatch());
+}
+
+
+TEST(SetValuesTest, FusedMatchesSeparateCalls)
+{
+	SetValues<FusedConstRosenbrock> fused;
+	SetValues<ConstRosenbrock> func;
+
+	for(auto p : { std::make_pair(0.1, 0.3), std::make_pair(0.5, 0.8), std::make_pair(0.3, 0.3) })
+	{
+		FusedConstRosenbrock::Vector a{ p.first, p.second };
+		ConstRosenbrock::Vector b{ p.first, p.second };
+
+		fused(a);
+		func(b);
+
+		EXPECT_DOUBLE_EQ(a.fitness, b.fitness);
+		EXPECT_DOUBLE_EQ(a.violation, b.violation);
+	}
+
+	EXPECT_EQ(*fused.calls, 3);
+	EXPECT_TRUE(SetValues<FusedConstRosenbrock>::hasFused());
+	EXPECT_FALSE(SetValues<ConstRosenbrock>::hasFused());
+}
+
+
+TEST(PopulationTest, AlignedRows)
+{
+	mde::help::Population pop(7, 13);
+
+	EXPECT_EQ(pop.size(), 7);
+	EXPECT_EQ(pop.cols(), 13);
+	EXPECT_GE(pop.stride(), 13);
+
+	for(int i = 0; i < pop.size(); ++i)
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(pop[i]) % mde::help::cacheLine, 0u);
+}
+
+
+TEST(PopulationTest, VectorRoundTrip)
+{
+	using Vector = mde::help::Vector<3>;
+
+	mde::help::Population pop(3, 3);
+
+	Vector a{ 1.0, 2.0, 3.0 }, b{ 4.0, 5.0, 6.0 }, c{ 7.0, 8.0, 9.0 };
+
+	a.fitness = 1.0, a.violation = 0.5;
+	b.fitness = 3.0, b.violation = 0.0;
+	c.fitness = 2.0, c.violation = 0.0;
+
+	pop.assign(0, a);
+	pop.assign(1, b);
+	pop.assign(2, c);
+
+	Vector first = pop.vector<Vector>(0), last = pop.vector<Vector>(2);
+
+	EXPECT_EQ(first[0], 1.0);
+	EXPECT_EQ(first.violation, 0.5);
+	EXPECT_EQ(last[2], 9.0);
+	EXPECT_EQ(last.fitness, 2.0);
+}
+
+
+TEST(VectorTest, StorageAndAlignment)
+{
+	using Small = mde::help::Vector<2>;
+	using Large = mde::help::Vector<50000>;
+	using Runtime = mde::help::Vector<>;
+
+	EXPECT_TRUE(Small::isArray);
+	EXPECT_TRUE(Large::isVector);
+	EXPECT_LT(sizeof(Large), 1024u);
+
+	Large large;
+
+	EXPECT_EQ(large.size(), 50000u);
+
+	for(int n : { 1, 16, 17, 1000 })
+	{
+		Runtime v(n, 2.0);
+
+		EXPECT_EQ(v.size(), std::size_t(n));
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(v.data()) % mde::help::cacheLine, 0u);
+
+		v.fitness = 3.0;
+
+		Runtime copy = v, moved = std::move(copy);
+
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(moved.data()) % mde::help::cacheLine, 0u);
+		EXPECT_EQ(std::vector<double>(moved), std::vector<double>(n, 2.0));
+		EXPECT_EQ(moved.fitness, 3.0);
+
+		moved.push_back(4.0);
+
+		EXPECT_EQ(moved.size(), std::size_t(n + 1));
+		EXPECT_EQ(moved.back(), 4.0);
+		EXPECT_EQ(moved[0], 2.0);
+	}
+}
+
+
+TEST(CacheTest, LeastRecentlyUsedEviction)
+{
+	mde::help::EvaluationCache cache(2, 2, 1);
+
+	double a[] = { 1.0, 2.0 }, b[] = { 3.0, 4.0 }, c[] = { 5.0, 6.0 };
+	double key[2], value;
+
+	auto insert = [&](const double* x, double v){ auto h = cache.key(x, key); cache.insert(key, h, &v); };
+	auto find = [&](const double* x){ auto h = cache.key(x, key); return cache.find(key, h, &value); };
+
+	insert(a, 10.0);
+	insert(b, 20.0);
+
+	EXPECT_TRUE(find(a));     /// Now 'b' is the least recently used
+	EXPECT_EQ(value, 10.0);
+
+	insert(c, 30.0);
+
+	EXPECT_FALSE(find(b));
+	EXPECT_TRUE(find(a));
+	EXPECT_TRUE(find(c));
+	EXPECT_EQ(value, 30.0);
+
+	EXPECT_EQ(cache.entries(), 2u);
+	EXPECT_EQ(cache.hits(), 3);
+	EXPECT_EQ(cache.misses(), 1);
+
+
+	/// With a resolution, close points share the same entry
+	cache.resize(4, 2, 1, 0.1);
+
+	double d[] = { 1.01, -0.0 }, e[] = { 0.99, 0.01 };
+
+	insert(d, 40.0);
+
+	EXPECT_TRUE(find(e));
+	EXPECT_EQ(value, 40.0);
+}
+
+
+TEST(StoreTest, SharedByManyWriters)
+{
+	const std::string path = ::testing::TempDir() + "mde_store_test.bin";
+
+	std::remove(path.c_str());
+
+	/// Each thread has its own mapping of the file, as if they were different processes
+	std::vector<std::thread> writers;
+
+	for(int t = 0; t < 4; ++t)
+		writers.emplace_back([&path, t]
+		{
+			mde::help::PersistentStore store;
+
+			store.open(path, "problem", 2, 1, 1 << 20);
+
+			for(int i = 0; i < 500; ++i)
+			{
+				double x[] = { double(t), double(i) }, key[2], value = t * 1000.0 + i;
+
+				store.insert(key, mde::help::candidateKey(x, key, 2), &value);
+			}
+		});
+
+	for(auto& w : writers)
+		w.join();
+
+
+	mde::help::PersistentStore store, other;
+
+	store.open(path, "problem", 2, 1, 0);
+	other.open(path, "other problem", 2, 1, 0);
+
+	for(int t = 0; t < 4; ++t)
+	{
+		for(int i = 0; i < 500; ++i)
+		{
+			double x[] = { double(t), double(i) }, key[2], value;
+
+			auto hash = mde::help::candidateKey(x, key, 2);
+
+			ASSERT_TRUE(store.find(key, hash, &value));
+			EXPECT_EQ(value, t * 1000.0 + i);
+
+			EXPECT_FALSE(other.find(key, hash, &value));
+		}
+	}
+
+	EXPECT_EQ(store.records(), 2000u);
+
+	std::remove(path.c_str());
+}
+
+
+TEST(StoreTest, ResolutionIsPartOfTheTag)
+{
+	const std::string path = ::testing::TempDir() + "mde_store_resolution.bin";
+
+	std::remove(path.c_str());
+
+	mde::help::PersistentStore exact, rounded, coarser;
+
+	exact.open(path, "problem", 2, 1, 1 << 20);
+	rounded.open(path, "problem", 2, 1, 0, 0.5);
+	coarser.open(path, "problem", 2, 1, 0, 0.25);
+
+	/// The exact key of (2, 3) is the rounded key of (1, 1.5), but they are different candidates
+	double x[] = { 2.0, 3.0 }, y[] = { 1.0, 1.5 }, key[2], value = 10.0;
+
+	exact.insert(key, mde::help::candidateKey(x, key, 2), &value);
+
+	const auto hash = mde::help::candidateKey(y, key, 2, 0.5);
+
+	EXPECT_FALSE(rounded.find(key, hash, &value));
+
+	value = 20.0;
+	rounded.insert(key, hash, &value);
+
+	EXPECT_TRUE(rounded.find(key, hash, &value));
+	EXPECT_EQ(value, 20.0);
+
+	EXPECT_FALSE(coarser.find(key, hash, &value));
+
+	EXPECT_TRUE(exact.find(key, mde::help::candidateKey(x, key, 2), &value));
+	EXPECT_EQ(value, 10.0);
+
+	std::remove(path.c_str());
+}
+
+
+TEST(StoreTest, SizeCap)
+{
+	const std::string path = ::testing::TempDir() + "mde_store_cap.bin";
+
+	std::remove(path.c_str());
+
+	mde::help::PersistentStore store;
+
+	store.open(path, "problem", 2, 1, 4096);
+
+	for(int i = 0; i < 1000; ++i)
+	{
+		double x[] = { 0.0, double(i) }, key[2], value = i;
+
+		store.insert(key, mde::help::candidateKey(x, key, 2), &value);
+	}
+
+	double x[] = { 0.0, 0.0 }, key[2], value;
+
+	EXPECT_TRUE(store.find(key, mde::help::candidateKey(x, key, 2), &value));
+	EXPECT_LT(store.records(), 1000u);
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	EXPECT_LE(std::size_t(file.tellg()), 4096u);
+
+	std::remove(path.c_str());
+}
+
+
+/// Mean squared error of a line fitted to the rows (x, y) of a data set
+struct LineFit : mde::Function<2>
+{
+	LineFit (const std::string& path = "") : mde::Function<2>(-10.0, 10.0)
+	{
+		if(!path.empty())
+			data.open(path, 2, 100);
+	}
+
+	void usePool (mde::help::ThreadPool* pool)
+	{
+		data.usePool(pool);
+	}
+
+	double operator () (const Vector& w)
+	{
+		return data.reduce([&](const double* rows, int count)
+		{
+			double sum = 0.0;
+
+			for(int r = 0; r < count; ++r, rows += 2)
+				sum += std::pow(w[0] * rows[0] + w[1] - rows[1], 2);
+
+			return sum;
+		}) / data.rows();
+	}
+
+	mde::Dataset data;
+};
+
+
+TEST(DatasetTest, ParallelReduction)
+{
+	const std::string path = ::testing::TempDir() + "mde_dataset.bin";
+
+	{
+		std::ofstream file(path, std::ios::binary);
+
+		for(int r = 0; r < 1050; ++r)
+		{
+			double row[2] = { r / 1050.0, 2.0 * (r / 1050.0) - 1.0 + 0.01 * std::sin(r) };
+
+			file.write(reinterpret_cast<const char*>(row), sizeof(row));
+		}
+	}
+
+	LineFit::Vector w(2);
+
+	w[0] = 1.0;
+	w[1] = 0.5;
+
+	LineFit serial(path);
+
+	EXPECT_EQ(serial.data.rows(), 1050u);
+	EXPECT_EQ(serial.data.shards(), 11);
+	EXPECT_DOUBLE_EQ(serial.data.row(1049)[0], 1049 / 1050.0);
+
+	const double expected = serial(w);
+
+	mde::help::ThreadPool pool(4);
+
+	LineFit parallel(path);
+
+	parallel.usePool(&pool);
+
+	/// The shards are added in order, so the result is exactly the same
+	EXPECT_EQ(parallel(w), expected);
+
+	/// Nested in a loop of the same pool, each reduction runs on its own thread
+	std::vector<double> nested(16);
+
+	pool.run(nested.size(), [&](int i, int){ nested[i] = parallel(w); });
+
+	for(double value : nested)
+		EXPECT_EQ(value, expected);
+
+
+	/// With fewer parents than threads, MDE evaluates one candidate at a time, each one using the whole pool
+	Parameters params;
+
+	params.threads = 8;
+	params.popSize = 6;
+	params.maxIter = 200;
+
+	MDE<LineFit> mde(params, LineFit(path));
+
+	EXPECT_FALSE(mde.parallelParents());
+
+	auto best = mde();
+
+	EXPECT_NEAR(best[0], 2.0, 1e-2);
+	EXPECT_NEAR(best[1], -1.0, 1e-2);
+
+	EXPECT_THROW(mde::Dataset(path, 8), std::runtime_error);   /// 2100 values are not rows of 8
+
+	std::remove(path.c_str());
+}
+
+
+TEST(MigrationQueueTest, SingleProducerSingleConsumer)
+{
+	mde::help::MigrationQueue queue(4, 3, 1);
+
+	const int count = 10000;
+
+	std::thread producer([&]
+	{
+		mde::help::Population row(1, 3, 1);
+
+		for(int i = 0; i < count; ++i)
+		{
+			std::fill(row[0], row[0] + 3, double(i));
+
+			row.fitness[0] = i;
+			row.violation[0] = -i;
+			row.constraintValues(0)[0] = 2.0 * i;
+
+			while(!queue.push(row, 0))
+				std::this_thread::yield();
+		}
+	});
+
+	mde::help::Population received(1, 3, 1);
+
+	for(int i = 0; i < count; ++i)
+	{
+		while(!queue.pop(received, 0))
+			std::this_thread::yield();
+
+		ASSERT_EQ(received.fitness[0], double(i));
+		ASSERT_EQ(received.violation[0], double(-i));
+		ASSERT_EQ(received[0][2], double(i));
+		ASSERT_EQ(received.constraintValues(0)[0], 2.0 * i);
+	}
+
+	producer.join();
+
+	EXPECT_FALSE(queue.pop(received, 0));
+}
+
+
+TEST(RankingTest, MatchesMDEComparison)
+{
+	::help::RandDouble randDouble(7);
+
+	mde::help::ThreadPool pool(4);
+
+	for(int n : { 5, 100, 5000 })
+	{
+		std::vector<double> fitness(n), violation(n);
+
+		for(int i = 0; i < n; ++i)
+		{
+			fitness[i] = i % 7 ? randDouble(-1e3, 1e3) : 0.0;
+			violation[i] = i % 3 ? 0.0 : randDouble(0.0, 10.0);
+		}
+
+		std::vector<int> expected(n);
+
+		std::iota(expected.begin(), expected.end(), 0);
+
+		std::stable_sort(expected.begin(), expected.end(), [&](int i, int j)
+		{
+			return mde::help::better(fitness[i], violation[i], fitness[j], violation[j]);
+		});
+
+		mde::help::Ranking ranking;
+
+		EXPECT_EQ(ranking(fitness.data(), violation.data(), n), expected);
+		EXPECT_EQ(ranking(fitness.data(), violation.data(), n, &pool), expected);
+
+		EXPECT_EQ(mde::help::Ranking::argmin(fitness.data(), violation.data(), n), expected[0]);
+	}
+}
+
+
+TEST(RandomTest, DistinctIndices)
+{
+	::help::RandInt randInt(42);
+
+	for(int rep = 0; rep < 10000; ++rep)
+	{
+		int r[3];
+
+		randInt.distinct(5, rep % 5, r, 3);
+
+		for(int j = 0; j < 3; ++j)
+		{
+			EXPECT_GE(r[j], 0);
+			EXPECT_LT(r[j], 5);
+			EXPECT_NE(r[j], rep % 5);
+		}
+
+		EXPECT_NE(r[0], r[1]);
+		EXPECT_NE(r[0], r[2]);
+		EXPECT_NE(r[1], r[2]);
+	}
+}
+
+
+TEST(RandomTest, UniformRanges)
+{
+	::help::RandInt randInt(7);
+	::help::RandDouble randDouble(7);
+
+	std::vector<int> counts(10);
+
+	for(int rep = 0; rep < 100000; ++rep)
+		counts[randInt(0, 10)]++;
+
+	for(int c : counts)
+		EXPECT_NEAR(c, 10000, 600);
+
+	std::vector<double> u(1000);
+
+	randDouble.fill(u.data(), u.size(), -2.0, 3.0);
+
+	for(double x : u)
+	{
+		EXPECT_GE(x, -2.0);
+		EXPECT_LT(x, 3.0);
+	}
+
+	EXPECT_NEAR(std::accumulate(u.begin(), u.end(), 0.0) / u.size(), 0.5, 0.2);
+}
+
+
+TEST(KernelsTest, MutationMatchesScalar)
+{
+	using namespace mde::help;
+
+	::help::RandDouble randDouble(3);
+
+	for(int N : { 1, 3, 4, 7, 8, 13, 16, 100 })
+	{
+		std::vector<std::vector<double>> v(7, std::vector<double>(N));
+
+		for(auto& x : v)
+			randDouble.fill(x.data(), N, -10.0, 10.0);
+
+		randDouble.fill(v[6].data(), N);
+
+		for(SimdLevel level : { SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512 })
+		{
+			if(int(level) > int(simdLevel()))
+				continue;
+
+			std::vector<double> child(N);
+
+			MutationArgs args{ child.data(), v[0].data(), v[1].data(), v[2].data(), v[3].data(), v[4].data(), v[6].data(), 0.5, 0.8, 0.1, N };
+
+			differentialMutation(args, N / 2, level);
+
+			for(int j = 0; j < N; ++j)
+			{
+				double expected = (v[6][j] < 0.5 || j == N / 2) ? v[2][j] + 0.8 * (v[3][j] - v[1][j]) + 0.1 * (v[4][j] - v[0][j]) : v[4][j];
+
+				EXPECT_NEAR(child[j], expected, 1e-12);
+			}
+		}
+	}
+}
+
+
+TEST(KernelsTest, BoundsMatchScalar)
+{
+	using namespace mde::help;
+
+	::help::RandDouble randDouble(5);
+
+	for(int N : { 1, 3, 4, 7, 8, 13, 16, 100 })
+	{
+		std::vector<double> lower(N, -1.0), upper(N, 2.0), parent(N), child(N);
+
+		randDouble.fill(parent.data(), N, -1.0, 2.0);
+		randDouble.fill(child.data(), N, -4.0, 5.0);
+
+		using Kernel = void (*)(const BoundsArgs&, SimdLevel);
+
+		for(Kernel kernel : { Kernel(clipBounds), Kernel(conservateBounds), Kernel(reflectBounds), Kernel(midpointBounds) })
+		{
+			std::vector<double> expected = child;
+
+			kernel({ expected.data(), parent.data(), lower.data(), upper.data(), N }, SimdLevel::Scalar);
+
+			for(int j = 0; j < N; ++j)
+			{
+				EXPECT_GE(expected[j], lower[j]);
+				EXPECT_LE(expected[j], upper[j]);
+			}
+
+			for(SimdLevel level : { SimdLevel::AVX2, SimdLevel::AVX512 })
+			{
+				if(int(level) > int(simdLevel()))
+					continue;
+
+				std::vector<double> result = child;
+
+				kernel({ result.data(), parent.data(), lower.data(), upper.data(), N }, level);
+
+				for(int j = 0; j < N; ++j)
+					EXPECT_NEAR(result[j], expected[j], 1e-12);
+			}
+		}
+
+
+		std::vector<double> inside = parent;
+
+		for(SimdLevel level : { SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512 })
+		{
+			if(int(level) > int(simdLevel()))
+				continue;
+
+			EXPECT_FALSE(outsideBounds({ inside.data(), parent.data(), lower.data(), upper.data(), N }, level));
+
+			inside[N - 1] = 3.0;
+
+			EXPECT_TRUE(outsideBounds({ inside.data(), parent.data(), lower.data(), upper.data(), N }, level));
+
+			inside[N - 1] = parent[N - 1];
+		}
+	}
+}
+
+
+TEST(KernelsTest, PenaltiesMatchScalar)
+{
+	using namespace mde::help;
+
+	::help::RandDouble randDouble(9);
+
+	for(int n : { 0, 1, 3, 4, 7, 8, 13, 16, 100 })
+	{
+		std::vector<double> values(n);
+
+		randDouble.fill(values.data(), n, -1.0, 1.0);
+
+		for(int i = 0; i < n; i += 3)
+			values[i] *= 1e-12;
+
+		double ineqs = inequalityPenaltyScalar(values.data(), n);
+		double eqs = equalityPenaltyScalar(values.data(), n, 1e-10);
+
+		for(SimdLevel level : { SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512 })
+		{
+			if(int(level) > int(simdLevel()))
+				continue;
+
+			EXPECT_NEAR(inequalityPenalty(values.data(), n, level), ineqs, 1e-12);
+			EXPECT_NEAR(equalityPenalty(values.data(), n, 1e-10, level), eqs, 1e-12);
+		}
+	}
+
+	/// A NaN inequality counts as 0 and a NaN equality gives NaN, in every lane of every version
+	for(int k = 0; k < 8; ++k)
+	{
+		std::vector<double> values(8, 0.5);
+
+		values[k] = std::numeric_limits<double>::quiet_NaN();
+
+		EXPECT_EQ(inequalityPenaltyScalar(values.data(), 8), 3.5);
+
+		for(SimdLevel level : { SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512 })
+		{
+			if(int(level) > int(simdLevel()))
+				continue;
+
+			EXPECT_EQ(inequalityPenalty(values.data(), 8, level), 3.5);
+			EXPECT_TRUE(std::isnan(equalityPenalty(values.data(), 8, 1e-10, level)));
+		}
+	}
+}
+
+
+TEST(ThreadPoolTest, RunsEveryIndexOnce)
+{
+	mde::help::ThreadPool pool(4);
+
+	std::vector<std::atomic<int>> counts(1000);
+
+	for(int rep = 0; rep < 10; ++rep)
+		pool.run(counts.size(), [&](int i, int worker)
+		{
+			EXPECT_GE(worker, 0);
+			EXPECT_LT(worker, pool.size());
+			counts[i]++;
+		});
+
+	for(auto& c : counts)
+		EXPECT_EQ(c.load(), 10);
+}
+
+
+TEST(ThreadPoolTest, RethrowsExceptions)
+{
+	mde::help::ThreadPool pool(4);
+
+	EXPECT_THROW(pool.run(100, [](int i, int){ if(i == 50) throw std::runtime_error("task"); }), std::runtime_error);
+
+	int sum = 0;
+
+	pool.run(10, [&](int i, int){ static std::mutex m; std::lock_guard<std::mutex> lock(m); sum += i; });
+
+	EXPECT_EQ(sum, 45);
+}
+
+
+TEST(ThreadPoolTest, NestedRunsOnCallingThread)
+{
+	mde::help::ThreadPool pool(4);
+
+	EXPECT_FALSE(pool.busy());
+
+	std::vector<std::atomic<int>> counts(64 * 10);
+
+	pool.run(64, [&](int i, int worker)
+	{
+		EXPECT_TRUE(pool.busy());
+
+		const std::thread::id outer = std::this_thread::get_id();
+
+		pool.run(10, [&](int j, int inner)
+		{
+			EXPECT_EQ(std::this_thread::get_id(), outer);
+			EXPECT_EQ(inner, worker);
+
+			counts[i * 10 + j]++;
+		});
+	});
+
+	EXPECT_FALSE(pool.busy());
+
+	for(auto& c : counts)
+		EXPECT_EQ(c.load(), 1);
+}
+
+
 
 
 } // namespace